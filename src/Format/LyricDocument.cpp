@@ -50,6 +50,33 @@ private:
     QVariant m_newValue;
     QVariant m_oldValue;
 };
+class BatchEditCommand : public QUndoCommand {
+public:
+    explicit BatchEditCommand(const QModelIndexList &indexes, const QVariantList &newValues, const QVariantList &oldValues, QUndoCommand *parent = nullptr)
+    : QUndoCommand(parent), m_indexes(indexes), m_newValues(newValues), m_oldValues(oldValues) {
+    }
+
+    void undo() override {
+        apply(m_oldValues);
+    }
+
+    void redo() override {
+        apply(m_newValues);
+    }
+
+private:
+    void apply(const QVariantList &values) {
+        m_instance->beginBatchUpdate();
+        for (int i = 0; i < m_indexes.size(); i++)
+            m_instance->model()->setData(m_indexes[i], values[i]);
+        m_instance->endBatchUpdate();
+        m_instance->setDirty(true);
+    }
+
+    QModelIndexList m_indexes;
+    QVariantList m_newValues;
+    QVariantList m_oldValues;
+};
 class MoveRowCommand : public QUndoCommand {
 public:
     explicit MoveRowCommand(int sourceRow, int destinationRow, QUndoCommand *parent = nullptr)
@@ -168,7 +195,7 @@ bool LyricDocument::openFile(const QString &fileName) {
     if (!ok)
         return false;
     newFile();
-    buildModelFromLyricLines(lyricLines);
+    appendLyricLines(lyricLines);
     setFileName(fileName);
     return true;
 }
@@ -224,6 +251,14 @@ void LyricDocument::pushEditCommand(const QModelIndex &index, const QVariant &va
     m_undoStack->push(new EditCommand(index.model() == m_proxyModel ? m_proxyModel->mapToSource(index) : index, value, previousValue));
 }
 
+void LyricDocument::pushBatchEditCommand(const QModelIndexList &indexes, const QVariantList &values, const QVariantList &previousValues) {
+    QModelIndexList sourceIndexes;
+    sourceIndexes.reserve(indexes.size());
+    for (const auto &index : indexes)
+        sourceIndexes.append(index.model() == m_proxyModel ? m_proxyModel->mapToSource(index) : index);
+    m_undoStack->push(new BatchEditCommand(sourceIndexes, values, previousValues));
+}
+
 void LyricDocument::pushMoveRowCommand(int sourceRow, int destinationRow) {
     m_undoStack->push(new MoveRowCommand(sourceRow, destinationRow));
 }
@@ -248,6 +283,17 @@ void LyricDocument::abortTransaction() {
     m_undoStack->undo();
 }
 
+void LyricDocument::beginBatchUpdate() {
+    // The proxy model re-sorts once when dynamic sorting is turned back on
+    if (m_batchUpdateDepth++ == 0)
+        m_proxyModel->setDynamicSortFilter(false);
+}
+
+void LyricDocument::endBatchUpdate() {
+    if (--m_batchUpdateDepth == 0)
+        m_proxyModel->setDynamicSortFilter(true);
+}
+
 int LyricDocument::findRowByTime(int time) const {
     int count = m_proxyModel->rowCount();
     int first = 0;
@@ -265,12 +311,25 @@ int LyricDocument::findRowByTime(int time) const {
     return first - 1;
 }
 
-void LyricDocument::buildModelFromLyricLines(const QList<LyricLine> &lyricLines) {
-    for (const auto &lyricLine : lyricLines) {
-        auto timeItem = new QStandardItem(QString::number(lyricLine.centisecond()));
-        auto lyricItem = new QStandardItem(lyricLine.lyric());
-        m_lyricModel->appendRow({timeItem, lyricItem});
+void LyricDocument::appendLyricLines(const QList<LyricLine> &lyricLines) {
+    if (lyricLines.isEmpty())
+        return;
+    beginBatchUpdate();
+    // All rows go in with a single rowsInserted, so views, the preview and the overview strip update once instead of once per line
+    auto firstRow = m_lyricModel->rowCount();
+    QList<QStandardItem *> timeItems;
+    timeItems.reserve(lyricLines.size());
+    for (const auto &lyricLine : lyricLines)
+        timeItems.append(new QStandardItem(QString::number(lyricLine.centisecond())));
+    m_lyricModel->invisibleRootItem()->insertRows(firstRow, timeItems);
+    // Filling the lyric column of rows that already exist only changes data, which is announced once for the whole range
+    {
+        QSignalBlocker blocker(m_lyricModel);
+        for (qsizetype i = 0; i < lyricLines.size(); i++)
+            m_lyricModel->setItem(firstRow + static_cast<int>(i), 1, new QStandardItem(lyricLines[i].lyric()));
     }
+    emit m_lyricModel->dataChanged(m_lyricModel->index(firstRow, 1), m_lyricModel->index(m_lyricModel->rowCount() - 1, 1));
+    endBatchUpdate();
 }
 
 QList<LyricLine> LyricDocument::getLyricLinesFromModel() const {
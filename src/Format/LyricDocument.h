@@ -2,6 +2,8 @@
 #define NEOLRCEDITORAPP_LYRICDOCUMENT_H
 
 #include <QObject>
+#include <QModelIndexList>
+#include <QVariant>
 
 class QStandardItemModel;
 class QUndoStack;
@@ -35,20 +37,25 @@ public:
     void beginTransaction(const QString &name);
     void pushEditCommand(const QModelIndex &index, const QVariant &value);
     void pushEditCommand(const QModelIndex &index, const QVariant &value, const QVariant &previousValue);
+    void pushBatchEditCommand(const QModelIndexList &indexes, const QVariantList &values, const QVariantList &previousValues);
     void pushMoveRowCommand(int sourceRow, int destinationRow);
     void pushInsertRowCommand(int row, int time, const QString &lyric);
     void pushDeleteRowCommand(int row);
     void commitTransaction();
     void abortTransaction();
 
+    void beginBatchUpdate();
+    void endBatchUpdate();
+
     int findRowByTime(int time) const;
 
+    void appendLyricLines(const QList<LyricLine> &lyricLines);
+
 signals:
     void fileNameChanged(const QString &fileName);
     void dirtyChanged(bool isDirty);
 
 private:
-    void buildModelFromLyricLines(const QList<LyricLine> &lyricLines);
     QList<LyricLine> getLyricLinesFromModel() const;
 
     void setFileName(const QString &fileName);
@@ -58,6 +65,7 @@ private:
     QUndoStack *m_undoStack;
     QString m_fileName;
     bool m_isDirty = false;
+    int m_batchUpdateDepth = 0;
 };
 
 
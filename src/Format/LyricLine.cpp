@@ -48,29 +48,26 @@ QString LyricLine::time() const {
 }
 
 QString LyricLine::toString() const {
-    return "[" + time() + "]" + d->lyric;
+    return "[" + TimeValidator::timeToLrcString(d->centisecond) + "]" + d->lyric;
 }
 
 QList<LyricLine> LyricLine::parse(const QString &lyricLineStr) {
-    static QRegularExpression rx(R"(^(\[\d\d:\d\d\.\d\d\])+(.*)$)");
+    // Accepts both [mm:ss.xx] with any number of minute digits and [hh:mm:ss.xx]
+    static QRegularExpression rx(R"(^((?:\[\d+:\d\d(?::\d\d)?\.\d\d\])+)(.*)$)");
+    static QRegularExpression tagRx(R"(\[([^\]]*)\])");
     auto match = rx.match(lyricLineStr);
     if (!match.hasMatch())
         return {};
     QList<LyricLine> ret;
-    auto lyric = match.captured(match.lastCapturedIndex());
-    for (int i = 1; i < match.lastCapturedIndex(); i++) {
-        auto captured = match.capturedView(i);
-        auto minuteStr = captured.mid(1, 2);
-        auto secondStr = captured.mid(4, 2);
-        auto centisecondStr = captured.mid(7, 2);
-        auto centisecond = minuteStr.toInt() * 6000 + secondStr.toInt() * 100 + centisecondStr.toInt();
-        ret.append({centisecond, lyric});
-    }
+    auto lyric = match.captured(2);
+    auto it = tagRx.globalMatch(match.capturedView(1));
+    while (it.hasNext())
+        ret.append({TimeValidator::stringToTime(it.next().captured(1)), lyric});
     return ret;
 }
 
 bool LyricLine::isValidLine(const QString &lyricLineStr) {
-    static QRegularExpression lineRx(R"(^(\[\d\d:\d\d\.\d\d\])+(.*)$)");
+    static QRegularExpression lineRx(R"(^(\[\d+:\d\d(?::\d\d)?\.\d\d\])+(.*)$)");
     static QRegularExpression metadataRx(R"(^\[([a-z#]*):(.*)\]$)");
     static QRegularExpression spaceRx(R"(^\s*$)");
     return lineRx.match(lyricLineStr).hasMatch() || metadataRx.match(lyricLineStr).hasMatch() || spaceRx.match(lyricLineStr).hasMatch();
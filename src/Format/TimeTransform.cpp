@@ -0,0 +1,189 @@
+#include "TimeTransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QStandardItemModel>
+#include <QSortFilterProxyModel>
+
+#include <NeoLrcEditorApp/LyricDocument.h>
+#include <NeoLrcEditorApp/TimeValidator.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#  include <emmintrin.h>
+#  define NEOLRCEDITORAPP_TIMETRANSFORM_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define NEOLRCEDITORAPP_TIMETRANSFORM_NEON
+#endif
+
+// Compilers keep std::floor, std::min and std::max on doubles scalar unless fast-math is on, so the kernels below are written with intrinsics and finish with a scalar tail
+
+#if defined(NEOLRCEDITORAPP_TIMETRANSFORM_SSE2)
+// SSE2 has no floor instruction: adding and subtracting 2^52 rounds to the nearest integer, and stepping down where that rounded up gives the floor. Larger values are already integers.
+static inline __m128d floorPd(__m128d x) {
+    auto signMask = _mm_set1_pd(-0.0);
+    auto magic = _mm_set1_pd(4503599627370496.0);
+    auto absolute = _mm_andnot_pd(signMask, x);
+    auto rounded = _mm_or_pd(_mm_sub_pd(_mm_add_pd(absolute, magic), magic), _mm_and_pd(signMask, x));
+    auto isSmall = _mm_cmplt_pd(absolute, magic);
+    rounded = _mm_or_pd(_mm_and_pd(isSmall, rounded), _mm_andnot_pd(isSmall, x));
+    return _mm_sub_pd(rounded, _mm_and_pd(_mm_cmpgt_pd(rounded, x), _mm_set1_pd(1.0)));
+}
+#endif
+
+static void quantizeKernel(double *times, qsizetype count, double div) {
+    qsizetype i = 0;
+#if defined(NEOLRCEDITORAPP_TIMETRANSFORM_SSE2)
+    auto divVector = _mm_set1_pd(div);
+    auto half = _mm_set1_pd(0.5);
+    for (; i + 2 <= count; i += 2) {
+        auto quantized = _mm_mul_pd(floorPd(_mm_add_pd(_mm_div_pd(_mm_loadu_pd(times + i), divVector), half)), divVector);
+        _mm_storeu_pd(times + i, floorPd(_mm_add_pd(quantized, half)));
+    }
+#elif defined(NEOLRCEDITORAPP_TIMETRANSFORM_NEON)
+    auto divVector = vdupq_n_f64(div);
+    auto half = vdupq_n_f64(0.5);
+    for (; i + 2 <= count; i += 2) {
+        auto quantized = vmulq_f64(vrndmq_f64(vaddq_f64(vdivq_f64(vld1q_f64(times + i), divVector), half)), divVector);
+        vst1q_f64(times + i, vrndmq_f64(vaddq_f64(quantized, half)));
+    }
+#endif
+    for (; i < count; i++)
+        times[i] = std::floor(std::floor(times[i] / div + 0.5) * div + 0.5);
+}
+
+static void scaleKernel(double *times, qsizetype count, double ratio, double offset) {
+    qsizetype i = 0;
+#if defined(NEOLRCEDITORAPP_TIMETRANSFORM_SSE2)
+    auto ratioVector = _mm_set1_pd(ratio);
+    auto offsetVector = _mm_set1_pd(offset + 0.5);
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_pd(times + i, floorPd(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(times + i), ratioVector), offsetVector)));
+#elif defined(NEOLRCEDITORAPP_TIMETRANSFORM_NEON)
+    auto ratioVector = vdupq_n_f64(ratio);
+    auto offsetVector = vdupq_n_f64(offset + 0.5);
+    for (; i + 2 <= count; i += 2)
+        vst1q_f64(times + i, vrndmq_f64(vaddq_f64(vmulq_f64(vld1q_f64(times + i), ratioVector), offsetVector)));
+#endif
+    for (; i < count; i++)
+        times[i] = std::floor(times[i] * ratio + (offset + 0.5));
+}
+
+static double minimumKernel(const double *times, qsizetype count) {
+    qsizetype i = 0;
+    auto minimum = std::numeric_limits<double>::infinity();
+#if defined(NEOLRCEDITORAPP_TIMETRANSFORM_SSE2)
+    auto minimumVector = _mm_set1_pd(minimum);
+    for (; i + 2 <= count; i += 2)
+        minimumVector = _mm_min_pd(minimumVector, _mm_loadu_pd(times + i));
+    minimum = _mm_cvtsd_f64(_mm_min_sd(minimumVector, _mm_unpackhi_pd(minimumVector, minimumVector)));
+#elif defined(NEOLRCEDITORAPP_TIMETRANSFORM_NEON)
+    auto minimumVector = vdupq_n_f64(minimum);
+    for (; i + 2 <= count; i += 2)
+        minimumVector = vminq_f64(minimumVector, vld1q_f64(times + i));
+    minimum = vminvq_f64(minimumVector);
+#endif
+    for (; i < count; i++)
+        minimum = std::min(minimum, times[i]);
+    return minimum;
+}
+
+static double maximumKernel(const double *times, qsizetype count) {
+    qsizetype i = 0;
+    auto maximum = -std::numeric_limits<double>::infinity();
+#if defined(NEOLRCEDITORAPP_TIMETRANSFORM_SSE2)
+    auto maximumVector = _mm_set1_pd(maximum);
+    for (; i + 2 <= count; i += 2)
+        maximumVector = _mm_max_pd(maximumVector, _mm_loadu_pd(times + i));
+    maximum = _mm_cvtsd_f64(_mm_max_sd(maximumVector, _mm_unpackhi_pd(maximumVector, maximumVector)));
+#elif defined(NEOLRCEDITORAPP_TIMETRANSFORM_NEON)
+    auto maximumVector = vdupq_n_f64(maximum);
+    for (; i + 2 <= count; i += 2)
+        maximumVector = vmaxq_f64(maximumVector, vld1q_f64(times + i));
+    maximum = vmaxvq_f64(maximumVector);
+#endif
+    for (; i < count; i++)
+        maximum = std::max(maximum, times[i]);
+    return maximum;
+}
+
+TimeTransform::TimeTransform(const QModelIndexList &indexes) {
+    auto document = LyricDocument::instance();
+    m_indexes.reserve(indexes.size());
+    m_oldTimes.reserve(indexes.size());
+    m_newTimes.reserve(indexes.size());
+    for (const auto &index : indexes) {
+        // Source indexes stay valid while the proxy model re-sorts
+        auto sourceIndex = (index.model() == document->proxyModel() ? document->proxyModel()->mapToSource(index) : index).siblingAtColumn(0);
+        auto time = sourceIndex.data().toInt();
+        m_indexes.append(sourceIndex);
+        m_oldTimes.append(time);
+        m_newTimes.append(time);
+    }
+}
+
+TimeTransform::~TimeTransform() = default;
+
+qsizetype TimeTransform::size() const {
+    return m_indexes.size();
+}
+
+QList<int> TimeTransform::times() const {
+    QList<int> ret;
+    ret.reserve(m_newTimes.size());
+    for (auto time : m_newTimes)
+        ret.append(static_cast<int>(time));
+    return ret;
+}
+
+void TimeTransform::quantize(double div) {
+    if (div <= 0)
+        return;
+    quantizeKernel(m_newTimes.data(), m_newTimes.size(), div);
+}
+
+void TimeTransform::scale(double ratio, int offset) {
+    scaleKernel(m_newTimes.data(), m_newTimes.size(), ratio, offset);
+}
+
+void TimeTransform::map(const std::function<double(int)> &function) {
+    for (auto &time : m_newTimes)
+        time = function(static_cast<int>(time));
+}
+
+bool TimeTransform::isValid() const {
+    if (m_newTimes.isEmpty())
+        return true;
+    // The vector minimum and maximum skip over NaN, so non-finite times have to be rejected on their own
+    if (!std::all_of(m_newTimes.cbegin(), m_newTimes.cend(), [](double time) { return std::isfinite(time); }))
+        return false;
+    return minimumKernel(m_newTimes.constData(), m_newTimes.size()) >= 0 && maximumKernel(m_newTimes.constData(), m_newTimes.size()) <= TimeValidator::MaximumTime;
+}
+
+bool TimeTransform::hasChanges() const {
+    for (qsizetype i = 0; i < m_indexes.size(); i++) {
+        if (static_cast<int>(m_newTimes[i]) != m_oldTimes[i])
+            return true;
+    }
+    return false;
+}
+
+bool TimeTransform::commit() const {
+    QModelIndexList indexes;
+    QVariantList values;
+    QVariantList previousValues;
+    for (qsizetype i = 0; i < m_indexes.size(); i++) {
+        auto time = static_cast<int>(m_newTimes[i]);
+        if (time == m_oldTimes[i])
+            continue;
+        indexes.append(m_indexes[i]);
+        values.append(time);
+        previousValues.append(m_oldTimes[i]);
+    }
+    if (indexes.isEmpty())
+        return false;
+    LyricDocument::instance()->pushBatchEditCommand(indexes, values, previousValues);
+    return true;
+}
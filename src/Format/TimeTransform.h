@@ -0,0 +1,34 @@
+#ifndef NEOLRCEDITORAPP_TIMETRANSFORM_H
+#define NEOLRCEDITORAPP_TIMETRANSFORM_H
+
+#include <functional>
+
+#include <QList>
+#include <QModelIndexList>
+
+class TimeTransform {
+public:
+    explicit TimeTransform(const QModelIndexList &indexes);
+    ~TimeTransform();
+
+    qsizetype size() const;
+    QList<int> times() const;
+
+    void quantize(double div);
+    void scale(double ratio, int offset);
+    // The function may return any value; isValid() rejects results that are not valid times
+    void map(const std::function<double(int)> &function);
+
+    bool isValid() const;
+
+    bool hasChanges() const;
+    bool commit() const;
+
+private:
+    QModelIndexList m_indexes;
+    QList<int> m_oldTimes;
+    QList<double> m_newTimes;
+};
+
+
+#endif //NEOLRCEDITORAPP_TIMETRANSFORM_H
@@ -8,31 +8,47 @@ TimeValidator::TimeValidator(QObject *parent) : QValidator(parent) {
 TimeValidator::~TimeValidator() = default;
 
 int TimeValidator::stringToTime(const QString &input) {
-    static QRegularExpression rx(R"(^\s*(\d*)\s*([:\x{ff1a}]?)\s*(\d*)\s*([\.\x{3002}\x{ff0e}]?)\s*(\d*)\s*$)");
+    // [[h:]m:]s[.xx], where minutes may exceed 59 when there is no hour field (extended-minute LRC)
+    static QRegularExpression rx(R"(^\s*(\d*)\s*([:\x{ff1a}]?)\s*(\d*)\s*(?:[:\x{ff1a}]\s*(\d*)\s*)?([\.\x{3002}\x{ff0e}]?)\s*(\d*)\s*$)");
     auto match = rx.match(input);
     auto capDigit1 = match.captured(1);
     auto capColon = match.captured(2);
     auto capDigit2 = match.captured(3);
-    auto capDot = match.captured(4);
-    auto capDigit3 = match.captured(5);
+    auto capDigit3 = match.captured(4);
+    auto capDot = match.captured(5);
+    auto capDigit4 = match.captured(6);
 
-    if (capDigit3.size() == 1)
-        capDigit3 += "0";
-    else if (capDigit3.size() > 2)
-        capDigit3 = capDigit3.mid(0, 2);
+    if (capDigit4.size() == 1)
+        capDigit4 += "0";
+    else if (capDigit4.size() > 2)
+        capDigit4 = capDigit4.mid(0, 2);
 
-    if (capColon.isEmpty() && capDot.isEmpty()) {
-        return capDigit1.toInt() * 100;
+    qint64 time;
+    if (match.hasCaptured(4)) {
+        time = capDigit1.toLongLong() * 360000 + capDigit2.toLongLong() * 6000 + capDigit3.toLongLong() * 100 + capDigit4.toLongLong();
+    } else if (capColon.isEmpty() && capDot.isEmpty()) {
+        time = capDigit1.toLongLong() * 100;
     } else if (capColon.isEmpty()) {
-        return capDigit1.toInt() * 100 + capDigit3.toInt();
+        time = capDigit1.toLongLong() * 100 + capDigit4.toLongLong();
     } else {
-        return capDigit1.toInt() * 6000 + capDigit2.toInt() * 100 + capDigit3.toInt();
+        time = capDigit1.toLongLong() * 6000 + capDigit2.toLongLong() * 100 + capDigit4.toLongLong();
     }
+    return static_cast<int>(qMin<qint64>(time, MaximumTime));
 }
 
 QString TimeValidator::timeToString(int t) {
-    if (t >= 600000)
-        t = 599999;
+    t = qBound(0, t, MaximumTime);
+    if (t < 360000)
+        return timeToLrcString(t);
+    return QStringLiteral("%1:%2:%3.%4").arg(t / 360000)
+                                        .arg(t % 360000 / 6000, 2, 10, QChar('0'))
+                                        .arg(t % 6000 / 100, 2, 10, QChar('0'))
+                                        .arg(t % 100, 2, 10, QChar('0'));
+}
+
+QString TimeValidator::timeToLrcString(int t) {
+    // Minutes are not wrapped into hours, which LRC players understand better than an hour field
+    t = qBound(0, t, MaximumTime);
     return QStringLiteral("%1:%2.%3").arg(t / 6000, 2, 10, QChar('0'))
                                      .arg(t % 6000 / 100, 2, 10, QChar('0'))
                                      .arg(t % 100, 2, 10, QChar('0'));
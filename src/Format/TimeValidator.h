@@ -9,11 +9,15 @@ public:
     explicit TimeValidator(QObject *parent = nullptr);
     ~TimeValidator() override;
 
+    // Centiseconds; just under 100 hours
+    static constexpr int MaximumTime = 100 * 360000 - 1;
+
     State validate(QString &input, int &) const override;
     void fixup(QString &input) const override;
 
     static int stringToTime(const QString &);
     static QString timeToString(int);
+    static QString timeToLrcString(int);
 };
 
 
@@ -0,0 +1,432 @@
+#include "DecodedAudioCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <QFile>
+#include <QTemporaryFile>
+#include <QThread>
+
+#include <TalcsFormat/AudioFormatIO.h>
+
+class DecodedAudioFormatIO : public talcs::AbstractAudioFormatIO {
+public:
+    explicit DecodedAudioFormatIO(std::shared_ptr<DecodedAudioCache> cache) : m_cache(std::move(cache)) {
+    }
+
+    bool open(OpenMode openMode) override {
+        if (openMode != Read)
+            return false;
+        m_openMode = openMode;
+        return true;
+    }
+
+    OpenMode openMode() const override {
+        return m_openMode;
+    }
+
+    void close() override {
+        m_openMode = NotOpen;
+    }
+
+    int channelCount() const override {
+        return m_cache->channelCount();
+    }
+
+    double sampleRate() const override {
+        return m_cache->sampleRate();
+    }
+
+    qint64 length() const override {
+        return m_cache->length();
+    }
+
+    qint64 read(float *ptr, qint64 length) override {
+        // Called on the audio thread: frames that are not decoded yet play as silence while the decoder catches up
+        length = qMin(length, m_cache->length() - m_position);
+        if (length <= 0)
+            return 0;
+        m_cache->requestReadAhead(m_position);
+        auto ret = m_cache->read(m_position, ptr, length);
+        std::fill(ptr + ret * m_cache->channelCount(), ptr + length * m_cache->channelCount(), 0.0f);
+        m_position += length;
+        return length;
+    }
+
+    qint64 write(const float *ptr, qint64 length) override {
+        return 0;
+    }
+
+    qint64 seek(qint64 pos) override {
+        m_position = qBound<qint64>(0, pos, m_cache->length());
+        m_cache->requestReadAhead(m_position);
+        return m_position;
+    }
+
+    qint64 pos() const override {
+        return m_position;
+    }
+
+private:
+    std::shared_ptr<DecodedAudioCache> m_cache;
+    OpenMode m_openMode = NotOpen;
+    qint64 m_position = 0;
+};
+
+DecodedAudioCache::DecodedAudioCache() = default;
+
+DecodedAudioCache::~DecodedAudioCache() {
+    close();
+}
+
+bool DecodedAudioCache::open(const QString &fileName) {
+    close();
+    auto file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+        return false;
+    auto io = std::make_unique<talcs::AudioFormatIO>(file.get());
+    if (!io->open(talcs::AbstractAudioFormatIO::Read))
+        return false;
+    auto channelCount = io->channelCount();
+    auto length = io->length();
+    if (channelCount <= 0 || length <= 0)
+        return false;
+    m_fileName = fileName;
+    m_channelCount = channelCount;
+    m_sampleRate = io->sampleRate();
+    m_length = length;
+    m_blockCount = ((length - 1) >> BlockShift) + 1;
+    m_blocks = std::make_unique<std::atomic<float *>[]>(m_blockCount);
+    m_readerCounts = std::make_unique<std::atomic<int>[]>(m_blockCount);
+    m_lastAccess = std::make_unique<std::atomic<qint64>[]>(m_blockCount);
+    m_file = std::move(file);
+    m_io = std::move(io);
+    m_decoderPosition = 0;
+    m_sequentialBlock = 0;
+    m_decodedBlockCount = 0;
+    m_heapByteCount = 0;
+    m_isStorageFileFailed = false;
+    m_readAheadPosition = 0;
+    m_priorityFirstBlock = 0;
+    m_priorityLastBlock = -1;
+    m_backgroundFirstBlock = 0;
+    m_backgroundLastBlock = -1;
+    m_isClosing = false;
+    m_decoderThread.reset(QThread::create([=] {
+        run();
+    }));
+    m_decoderThread->start(QThread::HighPriority);
+    return true;
+}
+
+void DecodedAudioCache::close() {
+    if (m_decoderThread) {
+        m_isClosing = true;
+        wake();
+        {
+            QMutexLocker locker(&m_progressMutex);
+            m_progressCondition.wakeAll();
+        }
+        m_decoderThread->wait();
+        m_decoderThread.reset();
+    }
+    if (m_io)
+        m_io->close();
+    m_io.reset();
+    m_file.reset();
+    if (m_blocks) {
+        for (qint64 index = 0; index < m_blockCount; index++) {
+            auto data = m_blocks[index].load(std::memory_order_relaxed);
+            if (!isMapped(data))
+                delete[] data;
+        }
+    }
+    for (const auto &[index, data] : std::as_const(m_retiredBlocks))
+        delete[] data;
+    m_retiredBlocks.clear();
+    m_blocks.reset();
+    m_readerCounts.reset();
+    m_lastAccess.reset();
+    m_mappedStorage = nullptr;
+    m_storageFile.reset();
+    m_decodedBlockCount = 0;
+    m_heapByteCount = 0;
+    m_fileName.clear();
+    m_channelCount = 0;
+    m_sampleRate = 0;
+    m_length = 0;
+    m_blockCount = 0;
+}
+
+QString DecodedAudioCache::fileName() const {
+    return m_fileName;
+}
+
+int DecodedAudioCache::channelCount() const {
+    return m_channelCount;
+}
+
+double DecodedAudioCache::sampleRate() const {
+    return m_sampleRate;
+}
+
+qint64 DecodedAudioCache::length() const {
+    return m_length;
+}
+
+void DecodedAudioCache::setPreDecodingEnabled(bool enabled) {
+    m_isPreDecodingEnabled = enabled;
+    wake();
+}
+
+bool DecodedAudioCache::isPreDecodingEnabled() const {
+    return m_isPreDecodingEnabled;
+}
+
+bool DecodedAudioCache::isPreDecoded() const {
+    return m_blockCount > 0 && m_decodedBlockCount.load(std::memory_order_acquire) == m_blockCount;
+}
+
+qint64 DecodedAudioCache::read(qint64 position, float *buffer, qint64 frameCount) const {
+    if (position < 0 || !m_blocks)
+        return 0;
+    frameCount = qMin(frameCount, m_length - position);
+    qint64 readCount = 0;
+    while (readCount < frameCount) {
+        auto index = (position + readCount) >> BlockShift;
+        // Entering the block before loading its pointer pairs with evictBlocks(), which unpublishes before checking for readers
+        m_readerCounts[index].fetch_add(1);
+        auto data = m_blocks[index].load();
+        qint64 count = 0;
+        if (data) {
+            auto offset = (position + readCount) - (index << BlockShift);
+            count = qMin(frameCount - readCount, blockLength(index) - offset);
+            std::memcpy(buffer + readCount * m_channelCount, data + offset * m_channelCount, count * m_channelCount * sizeof(float));
+            m_lastAccess[index].store(m_accessTick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        m_readerCounts[index].fetch_sub(1, std::memory_order_release);
+        if (!data)
+            break;
+        readCount += count;
+    }
+    return readCount;
+}
+
+bool DecodedAudioCache::isDecoded(qint64 position, qint64 frameCount) const {
+    if (!m_blocks)
+        return false;
+    auto last = qMin(position + frameCount, m_length) - 1;
+    for (auto index = qMax<qint64>(0, position) >> BlockShift; index <= last >> BlockShift; index++) {
+        if (!m_blocks[index].load(std::memory_order_acquire))
+            return false;
+    }
+    return true;
+}
+
+bool DecodedAudioCache::waitForDecoded(qint64 position, qint64 frameCount, QDeadlineTimer deadline) {
+    QMutexLocker locker(&m_progressMutex);
+    while (!isDecoded(position, frameCount)) {
+        if (m_isClosing || !m_progressCondition.wait(&m_progressMutex, deadline))
+            return isDecoded(position, frameCount);
+    }
+    return true;
+}
+
+void DecodedAudioCache::requestReadAhead(qint64 position) {
+    m_readAheadPosition.store(position, std::memory_order_relaxed);
+    // Steady playback only checks a few pointers; the decoder is woken when the window runs short
+    if (!isDecoded(position, qint64(ReadAheadBlockCount) << BlockShift))
+        wake();
+}
+
+void DecodedAudioCache::setPriorityRange(qint64 position, qint64 frameCount) {
+    if (frameCount <= 0) {
+        clearPriorityRange();
+        return;
+    }
+    m_priorityLastBlock.store(-1, std::memory_order_relaxed);
+    m_priorityFirstBlock.store(qMax<qint64>(0, position) >> BlockShift, std::memory_order_relaxed);
+    m_priorityLastBlock.store((position + frameCount - 1) >> BlockShift, std::memory_order_relaxed);
+    wake();
+}
+
+void DecodedAudioCache::clearPriorityRange() {
+    m_priorityLastBlock.store(-1, std::memory_order_relaxed);
+}
+
+void DecodedAudioCache::setBackgroundRange(qint64 position, qint64 frameCount) {
+    if (frameCount <= 0) {
+        clearBackgroundRange();
+        return;
+    }
+    auto firstBlock = qMax<qint64>(0, position) >> BlockShift;
+    auto lastBlock = (position + frameCount - 1) >> BlockShift;
+    if (firstBlock == m_backgroundFirstBlock.load(std::memory_order_relaxed) && lastBlock == m_backgroundLastBlock.load(std::memory_order_relaxed))
+        return;
+    m_backgroundLastBlock.store(-1, std::memory_order_relaxed);
+    m_backgroundFirstBlock.store(firstBlock, std::memory_order_relaxed);
+    m_backgroundLastBlock.store(lastBlock, std::memory_order_relaxed);
+    wake();
+}
+
+void DecodedAudioCache::clearBackgroundRange() {
+    m_backgroundLastBlock.store(-1, std::memory_order_relaxed);
+}
+
+talcs::AbstractAudioFormatIO *DecodedAudioCache::createFormatIO() {
+    return new DecodedAudioFormatIO(shared_from_this());
+}
+
+qint64 DecodedAudioCache::blockLength(qint64 index) const {
+    return qMin(qint64(1) << BlockShift, m_length - (index << BlockShift));
+}
+
+qint64 DecodedAudioCache::firstUndecodedBlock(qint64 first, qint64 last) const {
+    for (auto index = qMax<qint64>(0, first); index <= qMin(last, m_blockCount - 1); index++) {
+        if (!m_blocks[index].load(std::memory_order_relaxed))
+            return index;
+    }
+    return -1;
+}
+
+qint64 DecodedAudioCache::nextBlock() {
+    // Playback first, then the priority range (e.g. a loop region), then what waveform analysis waits for, then the whole file if pre-decoding
+    auto readAheadBlock = m_readAheadPosition.load(std::memory_order_relaxed) >> BlockShift;
+    if (auto index = firstUndecodedBlock(readAheadBlock, readAheadBlock + ReadAheadBlockCount - 1); index != -1)
+        return index;
+    if (auto index = firstUndecodedBlock(m_priorityFirstBlock.load(std::memory_order_relaxed), m_priorityLastBlock.load(std::memory_order_relaxed)); index != -1)
+        return index;
+    if (auto index = firstUndecodedBlock(m_backgroundFirstBlock.load(std::memory_order_relaxed), m_backgroundLastBlock.load(std::memory_order_relaxed)); index != -1)
+        return index;
+    if (!m_isPreDecodingEnabled)
+        return -1;
+    // Evicting a block moves this back, so every block before it is decoded
+    while (m_sequentialBlock < m_blockCount && m_blocks[m_sequentialBlock].load(std::memory_order_relaxed))
+        m_sequentialBlock++;
+    return m_sequentialBlock < m_blockCount ? m_sequentialBlock : -1;
+}
+
+void DecodedAudioCache::decodeBlock(qint64 index) {
+    auto start = index << BlockShift;
+    auto frameCount = blockLength(index);
+    float *data = nullptr;
+    // Pre-decoding keeps the whole track, so beyond the memory budget it goes to a memory-mapped file instead of the heap
+    if (m_isPreDecodingEnabled && m_length * m_channelCount * static_cast<qint64>(sizeof(float)) > MemoryBudget) {
+        if (auto storage = mappedStorage())
+            data = storage + start * m_channelCount;
+    }
+    if (!data) {
+        data = new float[frameCount * m_channelCount];
+        m_heapByteCount += frameCount * m_channelCount * static_cast<qint64>(sizeof(float));
+    }
+    if (m_decoderPosition != start)
+        m_io->seek(start);
+    qint64 readCount = 0;
+    while (readCount < frameCount) {
+        auto ret = m_io->read(data + readCount * m_channelCount, frameCount - readCount);
+        if (ret <= 0)
+            break;
+        readCount += ret;
+    }
+    std::fill(data + readCount * m_channelCount, data + frameCount * m_channelCount, 0.0f);
+    m_decoderPosition = start + readCount;
+    m_lastAccess[index].store(m_accessTick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    m_blocks[index].store(data, std::memory_order_release);
+    m_decodedBlockCount.fetch_add(1, std::memory_order_release);
+    {
+        QMutexLocker locker(&m_progressMutex);
+        m_progressCondition.wakeAll();
+    }
+    evictBlocks();
+}
+
+float *DecodedAudioCache::mappedStorage() {
+    if (m_mappedStorage || m_isStorageFileFailed)
+        return m_mappedStorage;
+    // The file is sparse, so only the decoded part takes up disk space
+    auto byteCount = m_length * m_channelCount * static_cast<qint64>(sizeof(float));
+    auto storageFile = std::make_unique<QTemporaryFile>();
+    uchar *data = nullptr;
+    if (storageFile->open() && storageFile->resize(byteCount))
+        data = storageFile->map(0, byteCount);
+    if (!data) {
+        m_isStorageFileFailed = true;
+        return nullptr;
+    }
+    m_storageFile = std::move(storageFile);
+    m_mappedStorage = reinterpret_cast<float *>(data);
+    return m_mappedStorage;
+}
+
+bool DecodedAudioCache::isMapped(const float *data) const {
+    return m_mappedStorage && data >= m_mappedStorage && data < m_mappedStorage + m_length * m_channelCount;
+}
+
+bool DecodedAudioCache::isEvictable(qint64 index) const {
+    // Blocks that playback, the loop region or waveform analysis are about to read stay
+    auto readAheadBlock = m_readAheadPosition.load(std::memory_order_relaxed) >> BlockShift;
+    if (index >= readAheadBlock - 1 && index < readAheadBlock + ReadAheadBlockCount)
+        return false;
+    if (index >= m_priorityFirstBlock.load(std::memory_order_relaxed) && index <= m_priorityLastBlock.load(std::memory_order_relaxed))
+        return false;
+    if (index >= m_backgroundFirstBlock.load(std::memory_order_relaxed) && index <= m_backgroundLastBlock.load(std::memory_order_relaxed))
+        return false;
+    return true;
+}
+
+void DecodedAudioCache::evictBlocks() {
+    // When pre-decoding could not map a file, everything stays in memory rather than being decoded over and over
+    if (m_isPreDecodingEnabled && !m_mappedStorage)
+        return;
+    while (m_heapByteCount > MemoryBudget) {
+        qint64 leastRecentlyUsedBlock = -1;
+        auto leastRecentAccess = std::numeric_limits<qint64>::max();
+        for (qint64 index = 0; index < m_blockCount; index++) {
+            auto data = m_blocks[index].load(std::memory_order_relaxed);
+            if (!data || isMapped(data) || !isEvictable(index))
+                continue;
+            auto access = m_lastAccess[index].load(std::memory_order_relaxed);
+            if (access < leastRecentAccess) {
+                leastRecentAccess = access;
+                leastRecentlyUsedBlock = index;
+            }
+        }
+        if (leastRecentlyUsedBlock == -1)
+            break;
+        auto data = m_blocks[leastRecentlyUsedBlock].exchange(nullptr);
+        m_decodedBlockCount.fetch_sub(1, std::memory_order_release);
+        m_heapByteCount -= blockLength(leastRecentlyUsedBlock) * m_channelCount * static_cast<qint64>(sizeof(float));
+        m_sequentialBlock = qMin(m_sequentialBlock, leastRecentlyUsedBlock);
+        m_retiredBlocks.append({leastRecentlyUsedBlock, data});
+    }
+    freeRetiredBlocks();
+}
+
+void DecodedAudioCache::freeRetiredBlocks() {
+    // A reader that entered the block before it was unpublished may still be copying from it
+    m_retiredBlocks.removeIf([=](const QPair<qint64, float *> &block) {
+        if (m_readerCounts[block.first].load() != 0)
+            return false;
+        delete[] block.second;
+        return true;
+    });
+}
+
+void DecodedAudioCache::run() {
+    while (!m_isClosing) {
+        freeRetiredBlocks();
+        // Read before looking for work, so that a request arriving in between is not slept through
+        auto sequence = m_requestSequence.load(std::memory_order_acquire);
+        auto index = nextBlock();
+        if (index == -1)
+            m_requestSequence.wait(sequence, std::memory_order_acquire);
+        else
+            decodeBlock(index);
+    }
+}
+
+void DecodedAudioCache::wake() {
+    m_requestSequence.fetch_add(1, std::memory_order_release);
+    m_requestSequence.notify_one();
+}
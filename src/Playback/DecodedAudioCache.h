@@ -0,0 +1,117 @@
+#ifndef NEOLRCEDITORAPP_DECODEDAUDIOCACHE_H
+#define NEOLRCEDITORAPP_DECODEDAUDIOCACHE_H
+
+#include <atomic>
+#include <memory>
+
+#include <QDeadlineTimer>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QWaitCondition>
+
+class QFile;
+class QTemporaryFile;
+class QThread;
+
+namespace talcs {
+    class AbstractAudioFormatIO;
+    class AudioFormatIO;
+}
+
+class DecodedAudioCache : public std::enable_shared_from_this<DecodedAudioCache> {
+public:
+    // Audio is decoded in blocks of 2^BlockShift frames
+    static constexpr int BlockShift = 16;
+    // Blocks after the read-ahead position that the decoder keeps ready
+    static constexpr int ReadAheadBlockCount = 4;
+    // Decoded blocks kept in memory; beyond this the least recently used ones are freed and decoded again when needed
+    static constexpr qint64 MemoryBudget = qint64(256) << 20;
+
+    DecodedAudioCache();
+    ~DecodedAudioCache();
+
+    bool open(const QString &fileName);
+    void close();
+
+    QString fileName() const;
+    int channelCount() const;
+    double sampleRate() const;
+    qint64 length() const;
+
+    // Keeps every block once decoded; tracks larger than the memory budget are then kept in a memory-mapped temporary file
+    void setPreDecodingEnabled(bool enabled);
+    bool isPreDecodingEnabled() const;
+    bool isPreDecoded() const;
+
+    // Never waits or locks: stops at the first frame that is not decoded yet
+    qint64 read(qint64 position, float *buffer, qint64 frameCount) const;
+    bool isDecoded(qint64 position, qint64 frameCount) const;
+    bool waitForDecoded(qint64 position, qint64 frameCount, QDeadlineTimer deadline);
+
+    // Lock-free, so this can be called from the audio thread
+    void requestReadAhead(qint64 position);
+
+    // Blocks in these ranges are decoded after the read-ahead window and are not freed while the range is set
+    void setPriorityRange(qint64 position, qint64 frameCount);
+    void clearPriorityRange();
+    void setBackgroundRange(qint64 position, qint64 frameCount);
+    void clearBackgroundRange();
+
+    talcs::AbstractAudioFormatIO *createFormatIO();
+
+private:
+    qint64 blockLength(qint64 index) const;
+    qint64 firstUndecodedBlock(qint64 first, qint64 last) const;
+    qint64 nextBlock();
+    void decodeBlock(qint64 index);
+    float *mappedStorage();
+    bool isMapped(const float *data) const;
+    bool isEvictable(qint64 index) const;
+    void evictBlocks();
+    void freeRetiredBlocks();
+    void run();
+    void wake();
+
+    QString m_fileName;
+    int m_channelCount = 0;
+    double m_sampleRate = 0;
+    qint64 m_length = 0;
+    qint64 m_blockCount = 0;
+
+    // Only the decoder thread uses the decoder, so nothing ever waits for it
+    std::unique_ptr<QFile> m_file;
+    std::unique_ptr<talcs::AudioFormatIO> m_io;
+    qint64 m_decoderPosition = 0;
+    qint64 m_sequentialBlock = 0;
+    std::unique_ptr<QThread> m_decoderThread;
+
+    // A block is published by storing its pointer. To free one, the decoder unpublishes it first and deletes it once no reader is inside it
+    std::unique_ptr<std::atomic<float *>[]> m_blocks;
+    std::unique_ptr<std::atomic<int>[]> m_readerCounts;
+    std::unique_ptr<std::atomic<qint64>[]> m_lastAccess;
+    mutable std::atomic<qint64> m_accessTick = 0;
+    std::atomic<qint64> m_decodedBlockCount = 0;
+    // Only touched by the decoder thread
+    qint64 m_heapByteCount = 0;
+    QList<QPair<qint64, float *>> m_retiredBlocks;
+    std::unique_ptr<QTemporaryFile> m_storageFile;
+    float *m_mappedStorage = nullptr;
+    bool m_isStorageFileFailed = false;
+
+    std::atomic<qint64> m_readAheadPosition = 0;
+    std::atomic<qint64> m_priorityFirstBlock = 0;
+    std::atomic<qint64> m_priorityLastBlock = -1;
+    std::atomic<qint64> m_backgroundFirstBlock = 0;
+    std::atomic<qint64> m_backgroundLastBlock = -1;
+    std::atomic<bool> m_isPreDecodingEnabled = false;
+    std::atomic<bool> m_isClosing = false;
+    // Bumped whenever there may be new work; the decoder thread sleeps on it
+    std::atomic<int> m_requestSequence = 0;
+
+    QMutex m_progressMutex;
+    QWaitCondition m_progressCondition;
+};
+
+
+#endif //NEOLRCEDITORAPP_DECODEDAUDIOCACHE_H
@@ -0,0 +1,96 @@
+#include "NullAudioOutput.h"
+
+#include <chrono>
+#include <thread>
+
+#include <QThread>
+
+#include <TalcsCore/AudioSource.h>
+
+NullAudioOutput::NullAudioOutput(talcs::AudioSource *source) : m_source(source) {
+}
+
+NullAudioOutput::~NullAudioOutput() {
+    stop();
+    if (m_isOpen)
+        m_source->close();
+}
+
+bool NullAudioOutput::start(Mode mode, qint64 bufferSize, double sampleRate) {
+    if (isRunning() || bufferSize <= 0 || sampleRate <= 0)
+        return false;
+    if (!m_isOpen || bufferSize != m_bufferSize || sampleRate != m_sampleRate) {
+        if (m_isOpen)
+            m_source->close();
+        m_isOpen = m_source->open(bufferSize, sampleRate);
+        if (!m_isOpen)
+            return false;
+    }
+    m_mode = mode;
+    m_bufferSize = bufferSize;
+    m_sampleRate = sampleRate;
+    // Offline output only renders when the caller asks for it
+    if (mode == Offline)
+        return true;
+    m_isStopRequested = false;
+    m_thread.reset(QThread::create([=] {
+        run();
+    }));
+    m_thread->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void NullAudioOutput::stop() {
+    if (!m_thread)
+        return;
+    m_isStopRequested = true;
+    m_thread->wait();
+    m_thread.reset();
+}
+
+bool NullAudioOutput::isRunning() const {
+    return m_thread != nullptr;
+}
+
+qint64 NullAudioOutput::render(qint64 length) {
+    if (isRunning() || !m_isOpen)
+        return 0;
+    auto bufferCount = (length + m_bufferSize - 1) / m_bufferSize;
+    for (qint64 i = 0; i < bufferCount; i++)
+        renderBuffer();
+    return bufferCount * m_bufferSize;
+}
+
+NullAudioOutput::Mode NullAudioOutput::mode() const {
+    return m_mode;
+}
+
+qint64 NullAudioOutput::bufferSize() const {
+    return m_bufferSize;
+}
+
+double NullAudioOutput::sampleRate() const {
+    return m_sampleRate;
+}
+
+qint64 NullAudioOutput::renderedLength() const {
+    return m_renderedLength;
+}
+
+void NullAudioOutput::run() {
+    auto bufferDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(static_cast<double>(m_bufferSize) / m_sampleRate));
+    auto deadline = std::chrono::steady_clock::now();
+    while (!m_isStopRequested) {
+        renderBuffer();
+        // Deadlines advance by whole buffers so that timing errors do not accumulate
+        deadline += bufferDuration;
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+void NullAudioOutput::renderBuffer() {
+    if (m_buffer.sampleCount() != m_bufferSize)
+        m_buffer.resize(2, m_bufferSize);
+    m_source->read(talcs::AudioSourceReadData(&m_buffer, 0, m_bufferSize));
+    m_renderedLength.fetch_add(m_bufferSize, std::memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+#ifndef NEOLRCEDITORAPP_NULLAUDIOOUTPUT_H
+#define NEOLRCEDITORAPP_NULLAUDIOOUTPUT_H
+
+#include <atomic>
+#include <memory>
+
+#include <QtGlobal>
+
+#include <TalcsCore/AudioBuffer.h>
+
+class QThread;
+
+namespace talcs {
+    class AudioSource;
+}
+
+// Pulls audio from a source without a sound card: paced like a real device, or offline where the caller drives render()
+class NullAudioOutput {
+public:
+    enum Mode {
+        RealTime,
+        Offline,
+    };
+
+    explicit NullAudioOutput(talcs::AudioSource *source);
+    ~NullAudioOutput();
+
+    bool start(Mode mode, qint64 bufferSize = 512, double sampleRate = 48000);
+    void stop();
+    bool isRunning() const;
+
+    // Renders synchronously on the calling thread; only in offline mode
+    qint64 render(qint64 length);
+
+    Mode mode() const;
+    qint64 bufferSize() const;
+    double sampleRate() const;
+    qint64 renderedLength() const;
+
+private:
+    void run();
+    void renderBuffer();
+
+    talcs::AudioSource *m_source;
+    Mode m_mode = RealTime;
+    qint64 m_bufferSize = 0;
+    double m_sampleRate = 0;
+    bool m_isOpen = false;
+    talcs::AudioBuffer m_buffer;
+    std::atomic<qint64> m_renderedLength = 0;
+    std::atomic<bool> m_isStopRequested = false;
+    std::unique_ptr<QThread> m_thread;
+};
+
+
+#endif //NEOLRCEDITORAPP_NULLAUDIOOUTPUT_H
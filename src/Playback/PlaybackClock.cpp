@@ -0,0 +1,126 @@
+#include "PlaybackClock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Interpolation never runs further than this ahead of the last audio timestamp
+static const double MaximumInterpolationSecond = 0.25;
+
+PlaybackClock::PlaybackClock() = default;
+
+PlaybackClock::~PlaybackClock() = default;
+
+void PlaybackClock::update(qint64 samplePosition, double sampleRate, double rate) {
+    // The audio thread must not wait for a seek on the GUI thread; the position it would have stored is superseded by the seek anyway, and the next block reports it again
+    if (!tryBeginWrite())
+        return;
+    m_rate.store(rate, std::memory_order_relaxed);
+    storePosition(samplePosition, sampleRate);
+    endWrite();
+}
+
+void PlaybackClock::seek(qint64 samplePosition, double sampleRate) {
+    beginWrite();
+    // An explicit seek begins a new run, while jumps reported by the audio thread (e.g. a loop restart) do not
+    m_runStartPosition.store(samplePosition, std::memory_order_relaxed);
+    storePosition(samplePosition, sampleRate);
+    endWrite();
+}
+
+void PlaybackClock::setRunning(bool isRunning) {
+    beginWrite();
+    if (isRunning)
+        m_runStartPosition.store(m_samplePosition.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_isRunning.store(isRunning, std::memory_order_relaxed);
+    m_timestamp.store(currentTimestamp(), std::memory_order_relaxed);
+    endWrite();
+}
+
+bool PlaybackClock::isRunning() const {
+    return m_isRunning.load(std::memory_order_relaxed);
+}
+
+void PlaybackClock::setLatency(double second) {
+    m_latency.store(second, std::memory_order_relaxed);
+}
+
+double PlaybackClock::latency() const {
+    return m_latency.load(std::memory_order_relaxed);
+}
+
+void PlaybackClock::setInterpolating(bool isInterpolating) {
+    m_isInterpolating.store(isInterpolating, std::memory_order_relaxed);
+}
+
+bool PlaybackClock::isInterpolating() const {
+    return m_isInterpolating.load(std::memory_order_relaxed);
+}
+
+double PlaybackClock::rate() const {
+    return m_rate.load(std::memory_order_relaxed);
+}
+
+double PlaybackClock::positionSecond() const {
+    return positionSecondAt(currentTimestamp());
+}
+
+double PlaybackClock::positionSecondAt(qint64 timestamp) const {
+    auto state = read();
+    if (state.sampleRate <= 0)
+        return 0;
+    auto second = static_cast<double>(state.samplePosition) / state.sampleRate;
+    if (state.isRunning) {
+        // The timestamp may also be slightly older than the last update, e.g. for input events
+        if (isInterpolating())
+            second += std::clamp(static_cast<double>(timestamp - state.timestamp) / 1e9, -MaximumInterpolationSecond, MaximumInterpolationSecond) * state.rate;
+        // The position reported by the audio thread is ahead of what is heard by the output latency, but it never goes back before where playback started
+        second = std::max(second - latency() * state.rate, static_cast<double>(state.runStartPosition) / state.sampleRate);
+    }
+    return second;
+}
+
+qint64 PlaybackClock::currentTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PlaybackClock::State PlaybackClock::read() const {
+    State state;
+    quint64 sequence;
+    do {
+        sequence = m_sequence.load(std::memory_order_acquire);
+        state.samplePosition = m_samplePosition.load(std::memory_order_relaxed);
+        state.sampleRate = m_sampleRate.load(std::memory_order_relaxed);
+        state.timestamp = m_timestamp.load(std::memory_order_relaxed);
+        state.runStartPosition = m_runStartPosition.load(std::memory_order_relaxed);
+        state.rate = m_rate.load(std::memory_order_relaxed);
+        state.isRunning = m_isRunning.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != m_sequence.load(std::memory_order_relaxed));
+    return state;
+}
+
+void PlaybackClock::storePosition(qint64 samplePosition, double sampleRate) {
+    m_samplePosition.store(samplePosition, std::memory_order_relaxed);
+    m_sampleRate.store(sampleRate, std::memory_order_relaxed);
+    m_timestamp.store(currentTimestamp(), std::memory_order_relaxed);
+}
+
+bool PlaybackClock::tryBeginWrite() {
+    if (m_writeLock.test_and_set(std::memory_order_acquire))
+        return false;
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void PlaybackClock::beginWrite() {
+    // The audio thread holds the lock only for a few stores, but it may be preempted, so give it the CPU back
+    while (!tryBeginWrite())
+        std::this_thread::yield();
+}
+
+void PlaybackClock::endWrite() {
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    m_writeLock.clear(std::memory_order_release);
+}
@@ -0,0 +1,63 @@
+#ifndef NEOLRCEDITORAPP_PLAYBACKCLOCK_H
+#define NEOLRCEDITORAPP_PLAYBACKCLOCK_H
+
+#include <atomic>
+
+#include <QtGlobal>
+
+class PlaybackClock {
+public:
+    PlaybackClock();
+    ~PlaybackClock();
+
+    void update(qint64 samplePosition, double sampleRate, double rate);
+    void seek(qint64 samplePosition, double sampleRate);
+    void setRunning(bool isRunning);
+    bool isRunning() const;
+
+    void setLatency(double second);
+    double latency() const;
+
+    void setInterpolating(bool isInterpolating);
+    bool isInterpolating() const;
+
+    double rate() const;
+
+    double positionSecond() const;
+    double positionSecondAt(qint64 timestamp) const;
+
+    static qint64 currentTimestamp();
+
+private:
+    struct State {
+        qint64 samplePosition;
+        double sampleRate;
+        qint64 timestamp;
+        qint64 runStartPosition;
+        double rate;
+        bool isRunning;
+    };
+    State read() const;
+    void storePosition(qint64 samplePosition, double sampleRate);
+    bool tryBeginWrite();
+    void beginWrite();
+    void endWrite();
+
+    // Sequence lock: odd while a writer is updating the fields below; only the GUI thread ever waits for the write lock
+    std::atomic<quint64> m_sequence = 0;
+    std::atomic_flag m_writeLock;
+    std::atomic<qint64> m_samplePosition = 0;
+    std::atomic<double> m_sampleRate = 0;
+    std::atomic<qint64> m_timestamp = 0;
+    std::atomic<qint64> m_runStartPosition = 0;
+    std::atomic<bool> m_isRunning = false;
+    // Source seconds played per wall-clock second
+    std::atomic<double> m_rate = 1.0;
+    // Wall-clock time from the audio callback until the samples are audible
+    std::atomic<double> m_latency = 0;
+    // Off when the audio is not rendered in real time, so that the position only moves with the rendered frames
+    std::atomic<bool> m_isInterpolating = true;
+};
+
+
+#endif //NEOLRCEDITORAPP_PLAYBACKCLOCK_H
@@ -1,6 +1,7 @@
 #include "PlaybackController.h"
 
-#include <QFile>
+#include <QGuiApplication>
+#include <QScreen>
 
 #include <TalcsCore/TransportAudioSource.h>
 #include <TalcsDevice/OutputContext.h>
@@ -8,29 +9,51 @@
 #include <TalcsDevice/AudioSourcePlayback.h>
 #include <TalcsFormat/AudioFormatIO.h>
 #include <TalcsFormat/AudioFormatInputSource.h>
-#include <TalcsGui/WaveformPainter.h>
+
+#include <NeoLrcEditorApp/DecodedAudioCache.h>
+#include <NeoLrcEditorApp/NullAudioOutput.h>
+#include <NeoLrcEditorApp/ScrubAudioSource.h>
+#include <NeoLrcEditorApp/TimeStretchAudioSource.h>
+#include <NeoLrcEditorApp/WaveformPeakCache.h>
 
 static PlaybackController *m_instance = nullptr;
 
 PlaybackController::PlaybackController(QObject *parent) : QObject(parent) {
     m_instance = this;
+    m_audioFileOpenPool.setMaxThreadCount(1);
     m_outputContext = std::make_unique<talcs::OutputContext>();
     m_transportAudioSource = std::make_unique<talcs::TransportAudioSource>();
     m_transportAudioSource->setLoopingRange(0, 0);
-    m_playback = std::make_unique<talcs::AudioSourcePlayback>(m_transportAudioSource.get());
+    m_timeStretchAudioSource = std::make_unique<TimeStretchAudioSource>(m_transportAudioSource.get());
+    m_scrubAudioSource = std::make_unique<ScrubAudioSource>(m_timeStretchAudioSource.get());
+    m_playback = std::make_unique<talcs::AudioSourcePlayback>(m_scrubAudioSource.get());
 
-    m_waveformPainter = std::make_unique<talcs::WaveformPainter>(m_waveformPainter.get());
+    m_waveformPeakCache = std::make_unique<WaveformPeakCache>();
 
-    connect(m_transportAudioSource.get(), &talcs::TransportAudioSource::positionAboutToChange, this, [=](int position) {
-        auto time = static_cast<int>(std::round(position / m_transportAudioSource->sampleRate() * 100));
-        if (m_positionTime != time) {
-            m_positionTime = time;
-            emit positionTimeChanged(time);
-        }
+    // Runs on the audio thread; the GUI samples the clock once per display frame instead. The stretcher has already consumed input it has not played yet, and the speed is the one the stretcher actually uses for this block
+    connect(m_transportAudioSource.get(), &talcs::TransportAudioSource::positionAboutToChange, this, [=](qint64 position) {
+        m_clock.update(position - m_timeStretchAudioSource->latency(), m_transportAudioSource->sampleRate(), m_timeStretchAudioSource->appliedSpeed());
+    }, Qt::DirectConnection);
+
+    auto screen = QGuiApplication::primaryScreen();
+    auto refreshRate = screen ? screen->refreshRate() : 60.0;
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    m_frameTimer.setInterval(static_cast<int>(1000.0 / qMax(1.0, refreshRate)));
+    connect(&m_frameTimer, &QTimer::timeout, this, &PlaybackController::updateFramePosition);
+
+    m_scrubTimer.setTimerType(Qt::PreciseTimer);
+    m_scrubTimer.setInterval(15);
+    connect(&m_scrubTimer, &QTimer::timeout, this, [=] {
+        if (m_isScrubPositionPending)
+            publishScrubPosition();
+        else
+            m_scrubTimer.stop();
     });
 }
 
 PlaybackController::~PlaybackController() {
+    m_audioFileOpenPool.clear();
+    m_audioFileOpenPool.waitForDone();
     m_instance = nullptr;
 }
 
@@ -39,83 +62,198 @@ PlaybackController *PlaybackController::instance() {
 }
 
 bool PlaybackController::initialize() {
+    if (m_isInitialized)
+        return true;
+    // Headless machines have no sound card: NEOLRCEDITOR_AUDIO_OUTPUT=null plays in real time into nothing, and =offline only renders when nullAudioOutput()->render() is called
+    auto outputName = qEnvironmentVariable("NEOLRCEDITOR_AUDIO_OUTPUT");
+    if (outputName == "null" || outputName == "offline") {
+        auto mode = outputName == "null" ? NullAudioOutput::RealTime : NullAudioOutput::Offline;
+        m_nullAudioOutput = std::make_unique<NullAudioOutput>(m_scrubAudioSource.get());
+        if (!m_nullAudioOutput->start(mode)) {
+            m_nullAudioOutput.reset();
+            return false;
+        }
+        m_clock.setLatency(mode == NullAudioOutput::RealTime ? static_cast<double>(m_nullAudioOutput->bufferSize()) / m_nullAudioOutput->sampleRate() : 0.0);
+        // Offline rendering is driven by tests, which need the position to depend on the rendered frames only
+        m_clock.setInterpolating(mode == NullAudioOutput::RealTime);
+        m_isInitialized = true;
+        return true;
+    }
     if (!m_outputContext->initialize())
         return false;
     if (!m_outputContext->device()->start(m_playback.get()))
         return false;
+    // A block is audible roughly one device buffer after the transport renders it
+    auto device = m_outputContext->device();
+    m_clock.setLatency(device->sampleRate() > 0 ? static_cast<double>(device->bufferSize()) / device->sampleRate() : 0.0);
+    m_isInitialized = true;
     return true;
 }
 
-bool PlaybackController::openAudioFile(const QString &fileName) {
-    auto file = std::make_unique<QFile>(fileName);
-    if (!file->open(QIODevice::ReadOnly))
-        return false;
-    auto io = std::make_unique<talcs::AudioFormatIO>(file.get());
-    if (!io->open(talcs::AbstractAudioFormatIO::Read)) {
-        return false;
-    }
-    auto replicaFile = std::make_unique<QFile>(fileName);
-    if (!replicaFile->open(QIODevice::ReadOnly))
-        return false;
-    auto replicaIO = std::make_unique<talcs::AudioFormatIO>(replicaFile.get());
-    if (!replicaIO->open(talcs::AbstractAudioFormatIO::Read)) {
-        return false;
+bool PlaybackController::isInitialized() const {
+    return m_isInitialized;
+}
+
+NullAudioOutput *PlaybackController::nullAudioOutput() const {
+    return m_nullAudioOutput.get();
+}
+
+void PlaybackController::openAudioFile(const QString &fileName) {
+    // Probing can take long for large compressed files, so it is done on a worker thread and the current file keeps playing until the swap
+    auto requestId = ++m_openRequestId;
+    m_audioFileOpenPool.clear();
+    m_audioFileOpenPool.start([=] {
+        // Playback and waveform analysis read from the same decoded blocks
+        auto decodedAudioCache = std::make_shared<DecodedAudioCache>();
+        if (decodedAudioCache->open(fileName)) {
+            decodedAudioCache->setPreDecodingEnabled(m_isPreDecodingEnabled);
+            // Let the first blocks be decoded so that playing right after the swap is not silent
+            decodedAudioCache->waitForDecoded(0, qint64(DecodedAudioCache::ReadAheadBlockCount) << DecodedAudioCache::BlockShift, QDeadlineTimer(500));
+        } else {
+            decodedAudioCache.reset();
+        }
+        QMetaObject::invokeMethod(this, [=] {
+            if (requestId == m_openRequestId)
+                swapAudioFile(fileName, decodedAudioCache);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PlaybackController::swapAudioFile(const QString &fileName, const std::shared_ptr<DecodedAudioCache> &decodedAudioCache) {
+    if (!decodedAudioCache) {
+        emit audioFileOpenFailed(fileName);
+        return;
     }
+    std::unique_ptr<talcs::AbstractAudioFormatIO> io(decodedAudioCache->createFormatIO());
+    io->open(talcs::AbstractAudioFormatIO::Read);
+    auto audioFormatInputSource = std::make_unique<talcs::AudioFormatInputSource>();
+    audioFormatInputSource->setAudioFormatIo(io.release(), true);
 
+    // The audio device is normally started after the main window is shown, but opening a file needs its sample rate
+    initialize();
     setPlaying(false);
-    m_audioFormatInputSource = std::make_unique<talcs::AudioFormatInputSource>();
-    m_audioFormatInputSource->setAudioFormatIo(io.release(), true);
-    m_audioFile = std::move(file);
-    m_transportAudioSource->setSource(m_audioFormatInputSource.get());
+    m_transportAudioSource->setSource(audioFormatInputSource.get());
+    m_audioFormatInputSource = std::move(audioFormatInputSource);
+    m_scrubAudioSource->setDecodedAudioCache(decodedAudioCache);
+    m_decodedAudioCache = decodedAudioCache;
     m_transportAudioSource->setPosition(0);
+    m_timeStretchAudioSource->reset();
     m_transportAudioSource->setLoopingRange(0, m_audioFormatInputSource->length());
+    m_loopStart = m_loopEnd = 0;
+    m_clock.seek(0, m_transportAudioSource->sampleRate());
     m_positionTime = 0;
 
-    m_replicaAudioFormatInputSource = std::make_unique<talcs::AudioFormatInputSource>();
-    m_replicaAudioFormatInputSource->setAudioFormatIo(replicaIO.get(), true);
-    m_replicaAudioFile = std::move(replicaFile);
-    m_replicaAudioFormatInputSource->open(1024, replicaIO->sampleRate());
-    m_waveformPainter->setSource(m_replicaAudioFormatInputSource.get(), replicaIO->channelCount(), replicaIO->length(), true);
-    m_waveformPainter->startLoad(0, replicaIO->length());
-
-    Q_UNUSED(replicaIO.release())
+    m_waveformPeakCache->load(decodedAudioCache);
 
     emit audioFileNameChanged(fileName);
-    return true;
+    emit audioFileOpened(fileName);
 }
 
 void PlaybackController::closeAudioFile() {
+    // Drop the result of an open that is still in progress
+    ++m_openRequestId;
     setPlaying(false);
+    m_scrubTimer.stop();
+    m_scrubAudioSource->setScrubbing(false);
     m_transportAudioSource->setSource(nullptr);
     m_audioFormatInputSource.reset();
-    m_audioFile.reset();
+    m_scrubAudioSource->setDecodedAudioCache(nullptr);
+    m_decodedAudioCache.reset();
     m_transportAudioSource->setPosition(0);
     m_transportAudioSource->setLoopingRange(0, 0);
+    m_loopStart = m_loopEnd = 0;
+    m_clock.seek(0, m_transportAudioSource->sampleRate());
     m_positionTime = 0;
 
-    m_waveformPainter->setSource(nullptr, 0, 0);
-    m_replicaAudioFormatInputSource.reset();
-    m_replicaAudioFile.reset();
+    m_waveformPeakCache->clear();
 
     emit audioFileNameChanged({});
 }
 
+void PlaybackController::setPreDecodingEnabled(bool enabled) {
+    m_isPreDecodingEnabled = enabled;
+    if (m_decodedAudioCache)
+        m_decodedAudioCache->setPreDecodingEnabled(enabled);
+}
+
+bool PlaybackController::isPreDecodingEnabled() const {
+    return m_isPreDecodingEnabled;
+}
+
 QString PlaybackController::audioFileName() const {
-    return m_audioFile ? m_audioFile->fileName() : QString();
+    return m_decodedAudioCache ? m_decodedAudioCache->fileName() : QString();
 }
 
 int PlaybackController::audioLengthTime() const {
     return m_audioFormatInputSource ? static_cast<int>(std::round(static_cast<double>(m_audioFormatInputSource->length()) / m_transportAudioSource->sampleRate() * 100.0)) : 0;
 }
 
+void PlaybackController::setLoopRange(int startTime, int endTime) {
+    if (!m_audioFormatInputSource)
+        return;
+    auto sampleRate = m_transportAudioSource->sampleRate();
+    auto length = m_audioFormatInputSource->length();
+    auto start = qBound<qint64>(0, static_cast<qint64>(std::round(startTime * sampleRate / 100.0)), length);
+    auto end = qBound<qint64>(0, static_cast<qint64>(std::round(endTime * sampleRate / 100.0)), length);
+    if (end <= start) {
+        clearLoopRange();
+        return;
+    }
+    if (start == m_loopStart && end == m_loopEnd)
+        return;
+    m_loopStart = start;
+    m_loopEnd = end;
+    // Keep the region decoded so that restarting the loop never waits for the decoder to seek; the cache counts frames of the file, not of the transport
+    auto fileSampleRate = m_decodedAudioCache->sampleRate();
+    auto fileStart = static_cast<qint64>(std::round(startTime * fileSampleRate / 100.0));
+    auto fileEnd = static_cast<qint64>(std::round(endTime * fileSampleRate / 100.0));
+    m_decodedAudioCache->setPriorityRange(fileStart, fileEnd - fileStart);
+    m_transportAudioSource->setLoopingRange(start, end);
+    setTransportPosition(start);
+    updateFramePosition();
+}
+
+void PlaybackController::clearLoopRange() {
+    if (!isLooping())
+        return;
+    m_loopStart = m_loopEnd = 0;
+    m_decodedAudioCache->clearPriorityRange();
+    m_transportAudioSource->setLoopingRange(0, m_audioFormatInputSource->length());
+}
+
+bool PlaybackController::isLooping() const {
+    return m_loopEnd > m_loopStart;
+}
+
+void PlaybackController::setPlaybackRate(double rate) {
+    rate = qBound(0.5, rate, 1.5);
+    if (qFuzzyCompare(rate, playbackRate()))
+        return;
+    // The audio thread picks the new speed up with its next block and reports it to the clock together with the position
+    m_timeStretchAudioSource->setSpeed(rate);
+    emit playbackRateChanged(m_timeStretchAudioSource->speed());
+}
+
+double PlaybackController::playbackRate() const {
+    return m_timeStretchAudioSource->speed();
+}
+
 void PlaybackController::setPlaying(bool isPlaying) {
     if (isPlaying == m_isPlaying)
         return;
     m_isPlaying = isPlaying;
     if (isPlaying) {
+        m_clock.setRunning(true);
         m_transportAudioSource->play();
+        m_frameTimer.start();
     } else {
+        // Stop where playback was heard rather than where the transport had already rendered to
+        auto position = static_cast<qint64>(std::round(m_clock.positionSecond() * m_transportAudioSource->sampleRate()));
         m_transportAudioSource->pause();
+        m_frameTimer.stop();
+        setTransportPosition(position);
+        m_clock.setRunning(false);
+        updateFramePosition();
     }
 }
 
@@ -125,17 +263,96 @@ bool PlaybackController::isPlaying() const {
 
 void PlaybackController::setPositionTime(int time) {
     if (m_positionTime != time) {
-        QSignalBlocker blocker(m_transportAudioSource.get());
         m_positionTime = time;
-        m_transportAudioSource->setPosition(static_cast<qint64>(std::round(time * m_transportAudioSource->sampleRate() / 100.0)));
+        setTransportPosition(static_cast<qint64>(std::round(time * m_transportAudioSource->sampleRate() / 100.0)));
         emit positionTimeChanged(time);
+        emit playheadPositionChanged(time / 100.0);
     }
 }
 
+void PlaybackController::beginScrub() {
+    if (!m_audioFormatInputSource || isScrubbing())
+        return;
+    m_wasPlayingBeforeScrub = m_isPlaying;
+    setPlaying(false);
+    m_isScrubPositionPending = false;
+    m_scrubAudioSource->setScrubbing(true);
+}
+
+void PlaybackController::scrubTo(int time) {
+    if (!isScrubbing())
+        return;
+    m_scrubTime = time;
+    m_isScrubPositionPending = true;
+    // The first update after a pause is published immediately, later ones wait for the timer
+    if (!m_scrubTimer.isActive()) {
+        publishScrubPosition();
+        m_scrubTimer.start();
+    }
+}
+
+void PlaybackController::endScrub() {
+    if (!isScrubbing())
+        return;
+    m_scrubTimer.stop();
+    m_isScrubPositionPending = false;
+    m_scrubAudioSource->setScrubbing(false);
+    setPlaying(m_wasPlayingBeforeScrub);
+}
+
+bool PlaybackController::isScrubbing() const {
+    return m_scrubAudioSource->isScrubbing();
+}
+
+void PlaybackController::publishScrubPosition() {
+    m_isScrubPositionPending = false;
+    if (!m_decodedAudioCache)
+        return;
+    // Grains are read straight from the decoded file, so the target is in file frames rather than transport samples
+    auto position = static_cast<qint64>(std::round(m_scrubTime * m_decodedAudioCache->sampleRate() / 100.0));
+    // Grains only play what is already decoded, so the decoder has to move to the target before the audio thread gets there
+    m_decodedAudioCache->requestReadAhead(position);
+    m_scrubAudioSource->setTargetPosition(position);
+}
+
 int PlaybackController::positionTime() const {
     return m_positionTime;
 }
 
-talcs::WaveformPainter *PlaybackController::waveformPainter() const {
-    return m_waveformPainter.get();
+double PlaybackController::positionSecond() const {
+    return m_clock.positionSecond();
+}
+
+int PlaybackController::clockTime() const {
+    return static_cast<int>(std::round(m_clock.positionSecond() * 100));
+}
+
+const PlaybackClock &PlaybackController::clock() const {
+    return m_clock;
+}
+
+void PlaybackController::setTransportPosition(qint64 position) {
+    {
+        QSignalBlocker blocker(m_transportAudioSource.get());
+        m_transportAudioSource->setPosition(position);
+    }
+    // Start decoding at the new position before the audio thread asks for it
+    if (m_decodedAudioCache && m_transportAudioSource->sampleRate() > 0)
+        m_decodedAudioCache->requestReadAhead(static_cast<qint64>(std::round(position * m_decodedAudioCache->sampleRate() / m_transportAudioSource->sampleRate())));
+    m_timeStretchAudioSource->reset();
+    m_clock.seek(position, m_transportAudioSource->sampleRate());
+}
+
+void PlaybackController::updateFramePosition() {
+    auto second = m_clock.positionSecond();
+    emit playheadPositionChanged(second);
+    auto time = static_cast<int>(std::round(second * 100));
+    if (m_positionTime != time) {
+        m_positionTime = time;
+        emit positionTimeChanged(time);
+    }
+}
+
+WaveformPeakCache *PlaybackController::waveformPeakCache() const {
+    return m_waveformPeakCache.get();
 }
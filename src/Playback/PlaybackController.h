@@ -1,19 +1,27 @@
 #ifndef NEOLRCEDITORAPP_PLAYBACKCONTROLLER_H
 #define NEOLRCEDITORAPP_PLAYBACKCONTROLLER_H
 
+#include <atomic>
 #include <memory>
 
 #include <QObject>
+#include <QTimer>
+#include <QThreadPool>
+
+#include <NeoLrcEditorApp/PlaybackClock.h>
 
 namespace talcs {
     class OutputContext;
     class AudioSourcePlayback;
     class TransportAudioSource;
     class AudioFormatInputSource;
-    class WaveformPainter;
 }
 
-class QFile;
+class DecodedAudioCache;
+class TimeStretchAudioSource;
+class ScrubAudioSource;
+class NullAudioOutput;
+class WaveformPeakCache;
 
 class PlaybackController : public QObject {
     Q_OBJECT
@@ -24,37 +32,83 @@ public:
     static PlaybackController *instance();
 
     bool initialize();
+    bool isInitialized() const;
+    NullAudioOutput *nullAudioOutput() const;
 
-    bool openAudioFile(const QString &fileName);
+    void openAudioFile(const QString &fileName);
     void closeAudioFile();
     QString audioFileName() const;
 
+    void setPreDecodingEnabled(bool enabled);
+    bool isPreDecodingEnabled() const;
+
     int audioLengthTime() const;
 
+    void setLoopRange(int startTime, int endTime);
+    void clearLoopRange();
+    bool isLooping() const;
+
+    void setPlaybackRate(double rate);
+    double playbackRate() const;
+
     void setPlaying(bool isPlaying);
     bool isPlaying() const;
 
     void setPositionTime(int time);
+
+    void beginScrub();
+    void scrubTo(int time);
+    void endScrub();
+    bool isScrubbing() const;
     int positionTime() const;
+    double positionSecond() const;
+    int clockTime() const;
+    const PlaybackClock &clock() const;
 
-    talcs::WaveformPainter *waveformPainter() const;
+    WaveformPeakCache *waveformPeakCache() const;
 
 signals:
     void audioFileNameChanged(const QString &fileName);
+    void audioFileOpened(const QString &fileName);
+    void audioFileOpenFailed(const QString &fileName);
+    void playbackRateChanged(double rate);
     void playingChanged(bool isPlaying);
     int positionTimeChanged(int positionTime);
+    void playheadPositionChanged(double second);
 
 private:
-    std::unique_ptr<QFile> m_audioFile;
+    void swapAudioFile(const QString &fileName, const std::shared_ptr<DecodedAudioCache> &decodedAudioCache);
+    void updateFramePosition();
+    void setTransportPosition(qint64 position);
+    void publishScrubPosition();
+
+    std::shared_ptr<DecodedAudioCache> m_decodedAudioCache;
     std::unique_ptr<talcs::AudioFormatInputSource> m_audioFormatInputSource;
     std::unique_ptr<talcs::TransportAudioSource> m_transportAudioSource;
+    std::unique_ptr<TimeStretchAudioSource> m_timeStretchAudioSource;
+    std::unique_ptr<ScrubAudioSource> m_scrubAudioSource;
     std::unique_ptr<talcs::AudioSourcePlayback> m_playback;
     std::unique_ptr<talcs::OutputContext> m_outputContext;
+    std::unique_ptr<NullAudioOutput> m_nullAudioOutput;
+
+    std::unique_ptr<WaveformPeakCache> m_waveformPeakCache;
+
+    QThreadPool m_audioFileOpenPool;
+    int m_openRequestId = 0;
+    std::atomic<bool> m_isPreDecodingEnabled = false;
+
+    PlaybackClock m_clock;
+    qint64 m_loopStart = 0;
+    qint64 m_loopEnd = 0;
+    QTimer m_frameTimer;
 
-    std::unique_ptr<talcs::WaveformPainter> m_waveformPainter;
-    std::unique_ptr<QFile> m_replicaAudioFile;
-    std::unique_ptr<talcs::AudioFormatInputSource> m_replicaAudioFormatInputSource;
+    // Drag events can arrive far more often than grains are played, so scrub targets are published at most once per interval
+    QTimer m_scrubTimer;
+    int m_scrubTime = 0;
+    bool m_isScrubPositionPending = false;
+    bool m_wasPlayingBeforeScrub = false;
 
+    bool m_isInitialized = false;
     bool m_isPlaying = false;
     int m_positionTime = 0;
 
@@ -0,0 +1,139 @@
+#include "ScrubAudioSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include <NeoLrcEditorApp/DecodedAudioCache.h>
+
+ScrubAudioSource::ScrubAudioSource(talcs::AudioSource *source) : m_source(source) {
+    m_window.resize(GrainLength);
+    for (int i = 0; i < GrainLength; i++)
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / GrainLength));
+}
+
+ScrubAudioSource::~ScrubAudioSource() = default;
+
+bool ScrubAudioSource::open(qint64 bufferSize, double sampleRate) {
+    if (!m_source->open(bufferSize, sampleRate))
+        return false;
+    if (!AudioSource::open(bufferSize, sampleRate))
+        return false;
+    std::lock_guard locker(m_decodedAudioCacheMutex);
+    allocateGrain();
+    return true;
+}
+
+void ScrubAudioSource::close() {
+    m_source->close();
+    AudioSource::close();
+}
+
+void ScrubAudioSource::setDecodedAudioCache(const std::shared_ptr<DecodedAudioCache> &decodedAudioCache) {
+    std::lock_guard locker(m_decodedAudioCacheMutex);
+    m_decodedAudioCache = decodedAudioCache;
+    allocateGrain();
+}
+
+void ScrubAudioSource::setScrubbing(bool isScrubbing) {
+    m_isScrubbing = isScrubbing;
+}
+
+bool ScrubAudioSource::isScrubbing() const {
+    return m_isScrubbing;
+}
+
+void ScrubAudioSource::setTargetPosition(qint64 position) {
+    m_targetPosition = position;
+}
+
+qint64 ScrubAudioSource::processReading(const talcs::AudioSourceReadData &readData) {
+    auto isScrubbing = m_isScrubbing.load();
+    auto channelCount = readData.buffer->channelCount();
+    if (isScrubbing && (!m_wasScrubbing || channelCount != m_channelCount))
+        resetState(channelCount);
+    m_wasScrubbing = isScrubbing;
+    if (!isScrubbing)
+        return m_source->read(readData);
+
+    qint64 writtenLength = 0;
+    while (writtenLength < readData.length) {
+        if (m_readyPosition == HopLength)
+            processGrain();
+        auto length = std::min(readData.length - writtenLength, HopLength - m_readyPosition);
+        for (int channel = 0; channel < channelCount; channel++)
+            readData.buffer->setSampleRange(channel, readData.startPos + writtenLength, length, m_readyBuffer, channel, m_readyPosition);
+        m_readyPosition += length;
+        writtenLength += length;
+    }
+    return readData.length;
+}
+
+void ScrubAudioSource::resetState(int channelCount) {
+    m_channelCount = channelCount;
+    m_readyBuffer.resize(channelCount, HopLength);
+    m_overlap.resize(channelCount);
+    for (auto &overlap : m_overlap)
+        overlap.fill(0.0f, GrainLength);
+    m_readyPosition = HopLength;
+    m_lastTargetPosition = -1;
+    m_holdGrainCount = MaximumHoldGrainCount;
+}
+
+void ScrubAudioSource::allocateGrain() {
+    // Sized for a whole grain at the file's rate, so the audio thread never allocates
+    if (!m_decodedAudioCache || sampleRate() <= 0)
+        return;
+    auto frameCount = sourceFrameCount(m_decodedAudioCache->sampleRate() / sampleRate());
+    m_grain.resize(frameCount * m_decodedAudioCache->channelCount());
+}
+
+qint64 ScrubAudioSource::sourceFrameCount(double step) {
+    return static_cast<qint64>(std::ceil((GrainLength - 1) * step)) + 2;
+}
+
+void ScrubAudioSource::processGrain() {
+    std::unique_lock locker(m_decodedAudioCacheMutex, std::try_to_lock);
+    // The target and the grains are in frames of the file, which are resampled to the device rate while windowing
+    auto step = locker.owns_lock() && m_decodedAudioCache && sampleRate() > 0 ? m_decodedAudioCache->sampleRate() / sampleRate() : 1.0;
+
+    // Each grain starts at the newest target; while the target holds still, playback continues forward for a short while
+    auto targetPosition = m_targetPosition.load();
+    if (targetPosition != m_lastTargetPosition) {
+        m_lastTargetPosition = targetPosition;
+        m_grainPosition = targetPosition;
+        m_holdGrainCount = 0;
+    } else {
+        m_grainPosition += static_cast<qint64>(std::llround(HopLength * step));
+        m_holdGrainCount++;
+    }
+
+    qint64 readCount = 0;
+    int sourceChannelCount = 0;
+    if (locker.owns_lock() && m_decodedAudioCache && m_holdGrainCount < MaximumHoldGrainCount) {
+        sourceChannelCount = m_decodedAudioCache->channelCount();
+        auto frameCount = std::min<qint64>(sourceFrameCount(step), m_grain.size() / sourceChannelCount);
+        readCount = m_decodedAudioCache->read(m_grainPosition, m_grain.data(), frameCount);
+    }
+    locker.unlock();
+
+    for (int channel = 0; channel < m_channelCount; channel++) {
+        auto &overlap = m_overlap[channel];
+        if (sourceChannelCount > 0) {
+            auto sourceChannel = std::min(channel, sourceChannelCount - 1);
+            for (int i = 0; i < GrainLength; i++) {
+                auto position = i * step;
+                auto index = static_cast<qint64>(position);
+                if (index + 1 >= readCount)
+                    break;
+                auto fraction = static_cast<float>(position - index);
+                auto sample = m_grain[index * sourceChannelCount + sourceChannel] * (1.0f - fraction) + m_grain[(index + 1) * sourceChannelCount + sourceChannel] * fraction;
+                overlap[i] += sample * m_window[i];
+            }
+        }
+        std::copy(overlap.cbegin(), overlap.cbegin() + HopLength, m_readyBuffer.data(channel));
+        std::copy(overlap.cbegin() + HopLength, overlap.cend(), overlap.begin());
+        std::fill(overlap.begin() + HopLength, overlap.end(), 0.0f);
+    }
+    m_readyPosition = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef NEOLRCEDITORAPP_SCRUBAUDIOSOURCE_H
+#define NEOLRCEDITORAPP_SCRUBAUDIOSOURCE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include <QList>
+
+#include <TalcsCore/AudioSource.h>
+#include <TalcsCore/AudioBuffer.h>
+
+class DecodedAudioCache;
+
+// While scrubbing, replaces the output of the source with short crossfaded grains read from the decoded audio at the target position
+class ScrubAudioSource : public talcs::AudioSource {
+public:
+    static constexpr int GrainLength = 2048;
+    static constexpr int HopLength = GrainLength / 2;
+    // Grains keep playing forward for this long after the target stops moving
+    static constexpr int MaximumHoldGrainCount = 4;
+
+    explicit ScrubAudioSource(talcs::AudioSource *source);
+    ~ScrubAudioSource() override;
+
+    bool open(qint64 bufferSize, double sampleRate) override;
+    void close() override;
+
+    void setDecodedAudioCache(const std::shared_ptr<DecodedAudioCache> &decodedAudioCache);
+
+    void setScrubbing(bool isScrubbing);
+    bool isScrubbing() const;
+    // In frames of the decoded file, which may have a different rate than the device
+    void setTargetPosition(qint64 position);
+
+protected:
+    qint64 processReading(const talcs::AudioSourceReadData &readData) override;
+
+private:
+    void resetState(int channelCount);
+    void allocateGrain();
+    static qint64 sourceFrameCount(double step);
+    void processGrain();
+
+    talcs::AudioSource *m_source;
+
+    // Only swapped by the GUI thread while the audio thread is not using it; the audio thread never waits for this lock
+    std::mutex m_decodedAudioCacheMutex;
+    std::shared_ptr<DecodedAudioCache> m_decodedAudioCache;
+
+    std::atomic<bool> m_isScrubbing = false;
+    std::atomic<qint64> m_targetPosition = 0;
+    bool m_wasScrubbing = false;
+
+    int m_channelCount = 0;
+    QList<float> m_window;
+    QList<float> m_grain;
+    QList<QList<float>> m_overlap;
+    talcs::AudioBuffer m_readyBuffer;
+    qint64 m_readyPosition = HopLength;
+
+    qint64 m_lastTargetPosition = -1;
+    qint64 m_grainPosition = 0;
+    int m_holdGrainCount = 0;
+};
+
+
+#endif //NEOLRCEDITORAPP_SCRUBAUDIOSOURCE_H
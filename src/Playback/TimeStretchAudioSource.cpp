@@ -0,0 +1,229 @@
+#include "TimeStretchAudioSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#  include <xmmintrin.h>
+#  define NEOLRCEDITORAPP_TIMESTRETCH_SSE
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define NEOLRCEDITORAPP_TIMESTRETCH_NEON
+#endif
+
+// Compilers do not vectorize a float reduction without fast-math, so the inner product of the similarity search is written with intrinsics, using four accumulators to hide the latency of the additions
+static float dotProduct(const float *a, const float *b, qsizetype length) {
+    qsizetype i = 0;
+    float sum = 0;
+#if defined(NEOLRCEDITORAPP_TIMESTRETCH_SSE)
+    auto sum0 = _mm_setzero_ps();
+    auto sum1 = _mm_setzero_ps();
+    auto sum2 = _mm_setzero_ps();
+    auto sum3 = _mm_setzero_ps();
+    for (; i + 16 <= length; i += 16) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    auto total = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+    total = _mm_add_ps(total, _mm_movehl_ps(total, total));
+    total = _mm_add_ss(total, _mm_shuffle_ps(total, total, 1));
+    sum = _mm_cvtss_f32(total);
+#elif defined(NEOLRCEDITORAPP_TIMESTRETCH_NEON)
+    auto sum0 = vdupq_n_f32(0);
+    auto sum1 = vdupq_n_f32(0);
+    auto sum2 = vdupq_n_f32(0);
+    auto sum3 = vdupq_n_f32(0);
+    for (; i + 16 <= length; i += 16) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        sum2 = vmlaq_f32(sum2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        sum3 = vmlaq_f32(sum3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    auto total = vaddq_f32(vaddq_f32(sum0, sum1), vaddq_f32(sum2, sum3));
+    auto half = vadd_f32(vget_low_f32(total), vget_high_f32(total));
+    sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+    for (; i < length; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+static void multiplyAdd(float *destination, const float *source, const float *window, qsizetype length) {
+    for (qsizetype i = 0; i < length; i++)
+        destination[i] += source[i] * window[i];
+}
+
+TimeStretchAudioSource::TimeStretchAudioSource(talcs::AudioSource *source) : m_source(source) {
+    m_window.resize(FrameLength);
+    // A periodic Hann window sums to one at 50% overlap
+    for (int i = 0; i < FrameLength; i++)
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / FrameLength));
+}
+
+TimeStretchAudioSource::~TimeStretchAudioSource() = default;
+
+bool TimeStretchAudioSource::open(qint64 bufferSize, double sampleRate) {
+    if (!m_source->open(bufferSize, sampleRate))
+        return false;
+    // Everything processReading() touches is allocated here, so seeks and channel changes on the audio thread only clear it
+    m_readBuffer.resize(MaximumChannelCount, HopLength);
+    m_readyBuffer.resize(MaximumChannelCount, HopLength);
+    m_input.resize(MaximumChannelCount);
+    m_overlap.resize(MaximumChannelCount);
+    for (int channel = 0; channel < MaximumChannelCount; channel++) {
+        m_input[channel].resize(InputCapacity);
+        m_overlap[channel].resize(FrameLength);
+    }
+    m_monoInput.resize(InputCapacity);
+    m_channelCount = 0;
+    return AudioSource::open(bufferSize, sampleRate);
+}
+
+void TimeStretchAudioSource::close() {
+    m_source->close();
+    AudioSource::close();
+}
+
+void TimeStretchAudioSource::setSpeed(double speed) {
+    m_speed = qBound(0.5, speed, 1.5);
+}
+
+double TimeStretchAudioSource::speed() const {
+    return m_speed;
+}
+
+double TimeStretchAudioSource::appliedSpeed() const {
+    return m_appliedSpeed.load(std::memory_order_relaxed);
+}
+
+qint64 TimeStretchAudioSource::latency() const {
+    return m_latency.load(std::memory_order_relaxed);
+}
+
+void TimeStretchAudioSource::reset() {
+    m_isResetRequested = true;
+}
+
+qint64 TimeStretchAudioSource::processReading(const talcs::AudioSourceReadData &readData) {
+    auto speed = m_speed.load();
+    auto bufferChannelCount = readData.buffer->channelCount();
+    auto channelCount = std::min(bufferChannelCount, MaximumChannelCount);
+    // Speed changes keep the buffered input, so only seeks and channel changes start over
+    if (m_isResetRequested.exchange(false) || channelCount != m_channelCount) {
+        m_isBypassed = speed == 1.0;
+        resetState(channelCount);
+    } else if (m_isBypassed && speed != 1.0) {
+        // Nothing is buffered while bypassed, so starting the stretcher drops no audio
+        m_isBypassed = false;
+        resetState(channelCount);
+    }
+    m_currentSpeed = speed;
+    m_appliedSpeed.store(speed, std::memory_order_relaxed);
+    if (m_isBypassed) {
+        m_latency.store(0, std::memory_order_relaxed);
+        return m_source->read(readData);
+    }
+
+    qint64 writtenLength = 0;
+    while (writtenLength < readData.length) {
+        if (m_readyPosition == HopLength)
+            processFrame();
+        auto length = std::min(readData.length - writtenLength, HopLength - m_readyPosition);
+        for (int channel = 0; channel < channelCount; channel++)
+            readData.buffer->setSampleRange(channel, readData.startPos + writtenLength, length, m_readyBuffer, channel, m_readyPosition);
+        for (int channel = channelCount; channel < bufferChannelCount; channel++)
+            readData.buffer->setSampleRange(channel, readData.startPos + writtenLength, length, m_readyBuffer, channelCount - 1, m_readyPosition);
+        m_readyPosition += length;
+        writtenLength += length;
+    }
+    // Source frames read ahead of the one being output, which is inside the frame that was synthesized last
+    auto outputPosition = m_previousFrameStart + m_readyPosition;
+    m_latency.store(m_inputStart + m_inputLength - outputPosition, std::memory_order_relaxed);
+    return readData.length;
+}
+
+void TimeStretchAudioSource::resetState(int channelCount) {
+    m_channelCount = channelCount;
+    for (int channel = 0; channel < channelCount; channel++)
+        std::fill(m_overlap[channel].begin(), m_overlap[channel].end(), 0.0f);
+    m_inputStart = 0;
+    m_inputLength = 0;
+    m_readyPosition = HopLength;
+    m_analysisPosition = SearchRadius;
+    m_previousFrameStart = -1;
+}
+
+void TimeStretchAudioSource::ensureInput(qint64 end) {
+    while (m_inputStart + m_inputLength < end) {
+        Q_ASSERT(m_inputLength + HopLength <= InputCapacity);
+        m_source->read(talcs::AudioSourceReadData(&m_readBuffer, 0, HopLength));
+        auto mono = m_monoInput.data() + m_inputLength;
+        std::fill(mono, mono + HopLength, 0.0f);
+        for (int channel = 0; channel < m_channelCount; channel++) {
+            auto data = m_readBuffer.constData(channel);
+            std::copy(data, data + HopLength, m_input[channel].data() + m_inputLength);
+            for (int i = 0; i < HopLength; i++)
+                mono[i] += data[i];
+        }
+        m_inputLength += HopLength;
+    }
+}
+
+void TimeStretchAudioSource::discardInput(qint64 before) {
+    auto count = before - m_inputStart;
+    if (count < 4 * FrameLength)
+        return;
+    // Moving the rest to the front keeps the buffers at their preallocated size
+    for (int channel = 0; channel < m_channelCount; channel++) {
+        auto data = m_input[channel].data();
+        std::copy(data + count, data + m_inputLength, data);
+    }
+    auto mono = m_monoInput.data();
+    std::copy(mono + count, mono + m_inputLength, mono);
+    m_inputStart = before;
+    m_inputLength -= count;
+}
+
+qint64 TimeStretchAudioSource::findBestOffset(qint64 nominalStart) const {
+    if (m_previousFrameStart < 0)
+        return nominalStart;
+    // The frame should continue the previous one as naturally as possible in the overlapping half
+    auto target = m_monoInput.constData() + (m_previousFrameStart + HopLength - m_inputStart);
+    auto targetEnergy = static_cast<double>(dotProduct(target, target, HopLength));
+    auto firstStart = qMax(m_inputStart, nominalStart - SearchRadius);
+    auto candidate = m_monoInput.constData() + (firstStart - m_inputStart);
+    // The candidate energy slides along with the window instead of being recomputed for every offset
+    auto candidateEnergy = static_cast<double>(dotProduct(candidate, candidate, HopLength));
+    auto bestStart = nominalStart;
+    auto bestScore = -std::numeric_limits<double>::infinity();
+    for (auto start = firstStart; start <= nominalStart + SearchRadius; start++, candidate++) {
+        auto score = dotProduct(target, candidate, HopLength) / std::sqrt(targetEnergy * qMax(0.0, candidateEnergy) + 1e-9);
+        if (score > bestScore) {
+            bestScore = score;
+            bestStart = start;
+        }
+        candidateEnergy += static_cast<double>(candidate[HopLength]) * candidate[HopLength] - static_cast<double>(candidate[0]) * candidate[0];
+    }
+    return bestStart;
+}
+
+void TimeStretchAudioSource::processFrame() {
+    auto nominalStart = static_cast<qint64>(std::llround(m_analysisPosition));
+    ensureInput(qMax(nominalStart + SearchRadius + FrameLength, m_previousFrameStart + 2 * HopLength));
+    auto start = findBestOffset(nominalStart);
+    for (int channel = 0; channel < m_channelCount; channel++) {
+        auto &overlap = m_overlap[channel];
+        multiplyAdd(overlap.data(), m_input[channel].constData() + (start - m_inputStart), m_window.constData(), FrameLength);
+        std::copy(overlap.cbegin(), overlap.cbegin() + HopLength, m_readyBuffer.data(channel));
+        std::copy(overlap.cbegin() + HopLength, overlap.cend(), overlap.begin());
+        std::fill(overlap.begin() + HopLength, overlap.end(), 0.0f);
+    }
+    m_readyPosition = 0;
+    m_previousFrameStart = start;
+    m_analysisPosition += HopLength * m_currentSpeed;
+    discardInput(qMin(static_cast<qint64>(m_analysisPosition) - SearchRadius, m_previousFrameStart + HopLength));
+}
@@ -0,0 +1,73 @@
+#ifndef NEOLRCEDITORAPP_TIMESTRETCHAUDIOSOURCE_H
+#define NEOLRCEDITORAPP_TIMESTRETCHAUDIOSOURCE_H
+
+#include <atomic>
+
+#include <QList>
+
+#include <TalcsCore/AudioSource.h>
+#include <TalcsCore/AudioBuffer.h>
+
+// Changes playback speed without changing pitch using WSOLA (waveform similarity overlap-add)
+class TimeStretchAudioSource : public talcs::AudioSource {
+public:
+    static constexpr int FrameLength = 1024;
+    static constexpr int HopLength = FrameLength / 2;
+    static constexpr int SearchRadius = 256;
+    // Buffers are allocated in open() for this many channels; the stretched last channel is copied into any further ones
+    static constexpr int MaximumChannelCount = 8;
+    // Room for the 4 * FrameLength that discardInput() lets accumulate plus what one frame reads past the discard point
+    static constexpr int InputCapacity = 8 * FrameLength;
+
+    explicit TimeStretchAudioSource(talcs::AudioSource *source);
+    ~TimeStretchAudioSource() override;
+
+    bool open(qint64 bufferSize, double sampleRate) override;
+    void close() override;
+
+    void setSpeed(double speed);
+    double speed() const;
+
+    // Both are published by the audio thread: the speed being applied, and how many source frames were read ahead of the one being output
+    double appliedSpeed() const;
+    qint64 latency() const;
+
+    void reset();
+
+protected:
+    qint64 processReading(const talcs::AudioSourceReadData &readData) override;
+
+private:
+    void resetState(int channelCount);
+    void ensureInput(qint64 end);
+    void discardInput(qint64 before);
+    qint64 findBestOffset(qint64 nominalStart) const;
+    void processFrame();
+
+    talcs::AudioSource *m_source;
+    std::atomic<double> m_speed = 1.0;
+    std::atomic<bool> m_isResetRequested = false;
+    double m_currentSpeed = 1.0;
+    bool m_isBypassed = true;
+    std::atomic<double> m_appliedSpeed = 1.0;
+    std::atomic<qint64> m_latency = 0;
+
+    int m_channelCount = 0;
+    talcs::AudioBuffer m_readBuffer;
+    // Input FIFO per channel plus a mono mix for the similarity search, each InputCapacity long; m_inputStart is the absolute index of the first sample and m_inputLength how many are valid
+    QList<QList<float>> m_input;
+    QList<float> m_monoInput;
+    qint64 m_inputStart = 0;
+    qint64 m_inputLength = 0;
+
+    QList<float> m_window;
+    QList<QList<float>> m_overlap;
+    talcs::AudioBuffer m_readyBuffer;
+    qint64 m_readyPosition = HopLength;
+
+    double m_analysisPosition = 0;
+    qint64 m_previousFrameStart = -1;
+};
+
+
+#endif //NEOLRCEDITORAPP_TIMESTRETCHAUDIOSOURCE_H
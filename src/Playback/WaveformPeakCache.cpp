@@ -0,0 +1,345 @@
+#include "WaveformPeakCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <NeoLrcEditorApp/DecodedAudioCache.h>
+
+static const quint32 CacheFileMagic = 0x4e4c504b;
+static const quint32 CacheFileVersion = 1;
+
+WaveformPeakCache::WaveformPeakCache(QObject *parent) : QObject(parent) {
+}
+
+WaveformPeakCache::~WaveformPeakCache() {
+    clear();
+}
+
+void WaveformPeakCache::load(const std::shared_ptr<DecodedAudioCache> &audioCache) {
+    clear();
+    m_thread.reset(QThread::create([=] {
+        run(audioCache.get());
+    }));
+    m_thread->start(QThread::LowPriority);
+}
+
+void WaveformPeakCache::clear() {
+    if (m_thread) {
+        m_isCancelled = true;
+        m_thread->wait();
+        m_thread.reset();
+        m_isCancelled = false;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_levels.clear();
+    m_sampleRate = 0;
+    m_length = 0;
+    m_chunkCount = 0;
+    m_loadedChunkCount = 0;
+    m_loadedChunks.clear();
+    locker.unlock();
+    emit cleared();
+}
+
+bool WaveformPeakCache::isLoaded() const {
+    QMutexLocker locker(&m_mutex);
+    return m_chunkCount != 0 && m_loadedChunkCount == m_chunkCount;
+}
+
+double WaveformPeakCache::sampleRate() const {
+    QMutexLocker locker(&m_mutex);
+    return m_sampleRate;
+}
+
+qint64 WaveformPeakCache::length() const {
+    QMutexLocker locker(&m_mutex);
+    return m_length;
+}
+
+QList<WaveformPeakCache::Peak> WaveformPeakCache::peaks(double startSample, double samplesPerPixel, int count) const {
+    QList<Peak> ret(count);
+    QMutexLocker locker(&m_mutex);
+    if (m_levels.isEmpty() || samplesPerPixel <= 0)
+        return ret;
+    auto level = qBound(0, static_cast<int>(std::floor(std::log2(samplesPerPixel))) - BaseShift, static_cast<int>(m_levels.size()) - 1);
+    const auto &levelPeaks = m_levels[level];
+    auto shift = BaseShift + level;
+    for (int i = 0; i < count; i++) {
+        auto first = qMax<qint64>(0, static_cast<qint64>(std::floor(startSample + i * samplesPerPixel)));
+        auto last = qMin(m_length, qMax(first + 1, static_cast<qint64>(std::floor(startSample + (i + 1) * samplesPerPixel))));
+        if (first >= last)
+            continue;
+        auto firstBucket = first >> shift;
+        auto lastBucket = ((last - 1) >> shift) + 1;
+        auto peak = levelPeaks[firstBucket];
+        double sumOfSquares = peak.rms * peak.rms;
+        for (auto bucket = firstBucket + 1; bucket < lastBucket; bucket++) {
+            const auto &p = levelPeaks[bucket];
+            peak.min = std::min(peak.min, p.min);
+            peak.max = std::max(peak.max, p.max);
+            sumOfSquares += p.rms * p.rms;
+        }
+        peak.rms = static_cast<float>(std::sqrt(sumOfSquares / static_cast<double>(lastBucket - firstBucket)));
+        ret[i] = peak;
+    }
+    return ret;
+}
+
+void WaveformPeakCache::setPriorityRegion(double visibleStartSecond, double visibleEndSecond, double playheadSecond) {
+    QMutexLocker locker(&m_mutex);
+    m_visibleStartSecond = visibleStartSecond;
+    m_visibleEndSecond = visibleEndSecond;
+    m_playheadSecond = playheadSecond;
+}
+
+QStringList WaveformPeakCache::cacheFileNames(const QString &audioFileName) {
+    QFileInfo fileInfo(audioFileName);
+    auto pathHash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return {
+        fileInfo.absoluteFilePath() + QStringLiteral(".nlpeaks"),
+        QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(QStringLiteral("waveform/%1.nlpeaks").arg(QString::fromLatin1(pathHash))),
+    };
+}
+
+void WaveformPeakCache::run(DecodedAudioCache *audioCache) {
+    auto audioFileName = audioCache->fileName();
+    QFileInfo fileInfo(audioFileName);
+    auto fileSize = fileInfo.size();
+    auto modifiedTime = fileInfo.lastModified().toMSecsSinceEpoch();
+    auto hash = contentHash(audioFileName);
+    auto cacheFiles = cacheFileNames(audioFileName);
+    for (const auto &cacheFileName : cacheFiles) {
+        if (restore(cacheFileName, fileSize, modifiedTime, hash)) {
+            emit loadFinished();
+            return;
+        }
+    }
+
+    // Decoded audio is shared with playback, so blocks that playback already decoded are reused. Chunks are analyzed as the decoder
+    // finishes them instead of being decoded on this thread, and only the chunks being analyzed are kept from being freed
+    allocate(audioCache->sampleRate(), audioCache->length());
+    QList<float> buffer;
+    for (;;) {
+        if (m_isCancelled) {
+            audioCache->clearBackgroundRange();
+            return;
+        }
+        qint64 preferredChunk = -1;
+        auto chunk = nextChunk(audioCache, preferredChunk);
+        if (preferredChunk == -1)
+            break;
+        // Steer the decoder towards what the user is looking at; the chunk after it keeps the decoder busy while this one is analyzed
+        audioCache->setBackgroundRange(preferredChunk << ChunkShift, qint64(2) << ChunkShift);
+        if (chunk == -1) {
+            audioCache->waitForDecoded(preferredChunk << ChunkShift, qint64(1) << ChunkShift, QDeadlineTimer(100));
+            continue;
+        }
+        // A chunk outside the background range may have been freed in between, in which case it is picked again later
+        if (!buildChunk(audioCache, chunk, buffer))
+            continue;
+        auto chunkLength = qMin(qint64(1) << ChunkShift, m_length - (chunk << ChunkShift));
+        emit chunkLoaded(static_cast<double>(chunk << ChunkShift) / m_sampleRate, static_cast<double>(chunkLength) / m_sampleRate);
+    }
+
+    audioCache->clearBackgroundRange();
+
+    for (const auto &cacheFileName : cacheFiles) {
+        if (persist(cacheFileName, fileSize, modifiedTime, hash))
+            break;
+    }
+    emit loadFinished();
+}
+
+void WaveformPeakCache::allocate(double sampleRate, qint64 length) {
+    QMutexLocker locker(&m_mutex);
+    m_sampleRate = sampleRate;
+    m_length = length;
+    m_levels.clear();
+    if (length <= 0)
+        return;
+    for (int level = 0; ; level++) {
+        auto bucketCount = ((length - 1) >> (BaseShift + level)) + 1;
+        m_levels.append(QList<Peak>(bucketCount));
+        if (bucketCount == 1)
+            break;
+    }
+    m_chunkCount = ((length - 1) >> ChunkShift) + 1;
+    m_loadedChunkCount = 0;
+    m_loadedChunks = QBitArray(m_chunkCount);
+}
+
+qint64 WaveformPeakCache::nextChunk(const DecodedAudioCache *audioCache, qint64 &preferredChunk) const {
+    // Returns the most wanted pending chunk that is already decoded; preferredChunk is the most wanted pending chunk
+    QMutexLocker locker(&m_mutex);
+    preferredChunk = -1;
+    if (m_loadedChunkCount == m_chunkCount)
+        return -1;
+    auto chunkAt = [=](double second) {
+        return qBound<qint64>(0, static_cast<qint64>(second * m_sampleRate) >> ChunkShift, m_chunkCount - 1);
+    };
+    auto isPending = [=](qint64 chunk) {
+        return chunk >= 0 && chunk < m_chunkCount && !m_loadedChunks.testBit(chunk);
+    };
+    QList<qint64> candidates;
+    for (auto chunk = chunkAt(m_visibleStartSecond); chunk <= chunkAt(m_visibleEndSecond); chunk++)
+        candidates.append(chunk);
+    auto playheadChunk = chunkAt(m_playheadSecond);
+    for (qint64 distance = 0; distance <= PlayheadWindowChunkCount; distance++) {
+        candidates.append(playheadChunk + distance);
+        candidates.append(playheadChunk - distance);
+    }
+    for (auto chunk : candidates) {
+        if (!isPending(chunk))
+            continue;
+        if (preferredChunk == -1)
+            preferredChunk = chunk;
+        if (audioCache->isDecoded(chunk << ChunkShift, qint64(1) << ChunkShift))
+            return chunk;
+    }
+    for (qint64 chunk = 0; chunk < m_chunkCount; chunk++) {
+        if (!isPending(chunk))
+            continue;
+        if (preferredChunk == -1)
+            preferredChunk = chunk;
+        if (audioCache->isDecoded(chunk << ChunkShift, qint64(1) << ChunkShift))
+            return chunk;
+    }
+    return -1;
+}
+
+bool WaveformPeakCache::buildChunk(DecodedAudioCache *audioCache, qint64 chunk, QList<float> &buffer) {
+    auto channelCount = audioCache->channelCount();
+    auto start = chunk << ChunkShift;
+    auto frameCount = qMin(qint64(1) << ChunkShift, m_length - start);
+    buffer.resize(frameCount * channelCount);
+    if (audioCache->read(start, buffer.data(), frameCount) != frameCount)
+        return false;
+
+    QList<QList<Peak>> chunkLevels(qMin(ChunkLevelCount, static_cast<int>(m_levels.size())));
+    auto &basePeaks = chunkLevels[0];
+    basePeaks.resize(((frameCount - 1) >> BaseShift) + 1);
+    for (qint64 i = 0; i < basePeaks.size(); i++) {
+        auto first = i << BaseShift;
+        auto last = qMin(first + (qint64(1) << BaseShift), frameCount);
+        auto minValue = std::numeric_limits<float>::max();
+        auto maxValue = std::numeric_limits<float>::lowest();
+        double sumOfSquares = 0;
+        for (auto j = first; j < last; j++) {
+            float sample = 0;
+            for (int channel = 0; channel < channelCount; channel++)
+                sample += buffer[j * channelCount + channel];
+            sample /= static_cast<float>(channelCount);
+            minValue = std::min(minValue, sample);
+            maxValue = std::max(maxValue, sample);
+            sumOfSquares += sample * sample;
+        }
+        basePeaks[i] = {minValue, maxValue, static_cast<float>(std::sqrt(sumOfSquares / static_cast<double>(last - first)))};
+    }
+    for (int level = 1; level < chunkLevels.size(); level++) {
+        const auto &children = chunkLevels[level - 1];
+        auto &parents = chunkLevels[level];
+        parents.resize((children.size() + 1) / 2);
+        for (qint64 i = 0; i < parents.size(); i++)
+            parents[i] = 2 * i + 1 < children.size() ? merge(children[2 * i], children[2 * i + 1]) : children[2 * i];
+    }
+
+    QMutexLocker locker(&m_mutex);
+    for (int level = 0; level < chunkLevels.size(); level++) {
+        auto offset = start >> (BaseShift + level);
+        std::copy(chunkLevels[level].cbegin(), chunkLevels[level].cend(), m_levels[level].begin() + offset);
+    }
+    for (auto level = chunkLevels.size(); level < m_levels.size(); level++) {
+        auto parent = start >> (BaseShift + level);
+        const auto &children = m_levels[level - 1];
+        m_levels[level][parent] = 2 * parent + 1 < children.size() ? merge(children[2 * parent], children[2 * parent + 1]) : children[2 * parent];
+    }
+    m_loadedChunks.setBit(chunk);
+    m_loadedChunkCount++;
+    return true;
+}
+
+bool WaveformPeakCache::restore(const QString &cacheFileName, qint64 fileSize, qint64 modifiedTime, const QByteArray &hash) {
+    QFile f(cacheFileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_5);
+    quint32 magic, version;
+    qint64 cachedFileSize, cachedModifiedTime;
+    QByteArray cachedHash;
+    double sampleRate;
+    qint64 length;
+    quint32 levelCount;
+    in >> magic >> version >> cachedFileSize >> cachedModifiedTime >> cachedHash >> sampleRate >> length >> levelCount;
+    if (in.status() != QDataStream::Ok || magic != CacheFileMagic || version != CacheFileVersion || levelCount > 64)
+        return false;
+    if (cachedFileSize != fileSize || cachedModifiedTime != modifiedTime || cachedHash != hash)
+        return false;
+    QList<QList<Peak>> levels(levelCount);
+    for (auto &level : levels) {
+        qint64 bucketCount;
+        in >> bucketCount;
+        if (in.status() != QDataStream::Ok || bucketCount <= 0)
+            return false;
+        level.resize(bucketCount);
+        auto byteCount = static_cast<qint64>(bucketCount * sizeof(Peak));
+        if (in.readRawData(reinterpret_cast<char *>(level.data()), byteCount) != byteCount)
+            return false;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_levels = std::move(levels);
+    m_sampleRate = sampleRate;
+    m_length = length;
+    m_chunkCount = length > 0 ? ((length - 1) >> ChunkShift) + 1 : 0;
+    m_loadedChunkCount = m_chunkCount;
+    m_loadedChunks = QBitArray(m_chunkCount, true);
+    return true;
+}
+
+bool WaveformPeakCache::persist(const QString &cacheFileName, qint64 fileSize, qint64 modifiedTime, const QByteArray &hash) const {
+    QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+    QSaveFile f(cacheFileName);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_5);
+    out << CacheFileMagic << CacheFileVersion << fileSize << modifiedTime << hash << m_sampleRate << m_length << static_cast<quint32>(m_levels.size());
+    for (const auto &level : m_levels) {
+        out << static_cast<qint64>(level.size());
+        out.writeRawData(reinterpret_cast<const char *>(level.constData()), static_cast<int>(level.size() * sizeof(Peak)));
+    }
+    if (out.status() != QDataStream::Ok) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+WaveformPeakCache::Peak WaveformPeakCache::merge(const Peak &a, const Peak &b) {
+    return {std::min(a.min, b.min), std::max(a.max, b.max), std::sqrt((a.rms * a.rms + b.rms * b.rms) / 2.0f)};
+}
+
+QByteArray WaveformPeakCache::contentHash(const QString &fileName) {
+    static const qint64 SampleSize = 1 << 20;
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return {};
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(f.read(SampleSize));
+    if (f.size() > SampleSize) {
+        f.seek(qMax(SampleSize, f.size() - SampleSize));
+        hash.addData(f.read(SampleSize));
+    }
+    return hash.result();
+}
@@ -0,0 +1,82 @@
+#ifndef NEOLRCEDITORAPP_WAVEFORMPEAKCACHE_H
+#define NEOLRCEDITORAPP_WAVEFORMPEAKCACHE_H
+
+#include <atomic>
+#include <memory>
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QBitArray>
+
+class QThread;
+
+class DecodedAudioCache;
+
+class WaveformPeakCache : public QObject {
+    Q_OBJECT
+public:
+    struct Peak {
+        float min = 0;
+        float max = 0;
+        float rms = 0;
+    };
+
+    explicit WaveformPeakCache(QObject *parent = nullptr);
+    ~WaveformPeakCache() override;
+
+    void load(const std::shared_ptr<DecodedAudioCache> &audioCache);
+    void clear();
+
+    bool isLoaded() const;
+    double sampleRate() const;
+    qint64 length() const;
+
+    QList<Peak> peaks(double startSample, double samplesPerPixel, int count) const;
+
+    void setPriorityRegion(double visibleStartSecond, double visibleEndSecond, double playheadSecond);
+
+    static QStringList cacheFileNames(const QString &audioFileName);
+
+signals:
+    void chunkLoaded(double startSecond, double lengthSecond);
+    void loadFinished();
+    void cleared();
+
+private:
+    // Level 0 stores one peak per 2^BaseShift samples, level n per 2^(BaseShift + n) samples
+    static constexpr int BaseShift = 7;
+    // Audio is analyzed in chunks of 2^ChunkShift samples
+    static constexpr int ChunkShift = 20;
+    static constexpr int ChunkLevelCount = ChunkShift - BaseShift + 1;
+    // Chunks within this distance of the playhead are analyzed before the rest of the file
+    static constexpr qint64 PlayheadWindowChunkCount = 16;
+
+    void run(DecodedAudioCache *audioCache);
+    void allocate(double sampleRate, qint64 length);
+    qint64 nextChunk(const DecodedAudioCache *audioCache, qint64 &preferredChunk) const;
+    bool buildChunk(DecodedAudioCache *audioCache, qint64 chunk, QList<float> &buffer);
+    bool restore(const QString &cacheFileName, qint64 fileSize, qint64 modifiedTime, const QByteArray &hash);
+    bool persist(const QString &cacheFileName, qint64 fileSize, qint64 modifiedTime, const QByteArray &hash) const;
+
+    static Peak merge(const Peak &a, const Peak &b);
+    static QByteArray contentHash(const QString &fileName);
+
+    mutable QMutex m_mutex;
+    QList<QList<Peak>> m_levels;
+    double m_sampleRate = 0;
+    qint64 m_length = 0;
+    qint64 m_chunkCount = 0;
+    qint64 m_loadedChunkCount = 0;
+    QBitArray m_loadedChunks;
+
+    double m_visibleStartSecond = 0;
+    double m_visibleEndSecond = 0;
+    double m_playheadSecond = 0;
+
+    std::unique_ptr<QThread> m_thread;
+    std::atomic<bool> m_isCancelled = false;
+};
+
+
+#endif //NEOLRCEDITORAPP_WAVEFORMPEAKCACHE_H
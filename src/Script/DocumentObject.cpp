@@ -1,15 +1,18 @@
 #include "DocumentObject.h"
 
+#include <cmath>
+
 #include <QStandardItemModel>
 #include <QSortFilterProxyModel>
 #include <QJSValue>
 #include <QJSEngine>
-#include <QTreeView>
 
 #include <NeoLrcEditorApp/ItemObject.h>
 #include <NeoLrcEditorApp/LyricDocument.h>
 #include <NeoLrcEditorApp/MainWindow.h>
+#include <NeoLrcEditorApp/LyricSelection.h>
 #include <NeoLrcEditorApp/PlaybackController.h>
+#include <NeoLrcEditorApp/TimeTransform.h>
 
 DocumentObject::DocumentObject(QObject *parent) : QObject(parent) {
 }
@@ -47,14 +50,43 @@ QJSValue DocumentObject::items() const {
 QJSValue DocumentObject::selectedItems() const {
     auto engine = qjsEngine(this);
     QList<QJSValue> ret;
-    for (const auto &index : MainWindow::instance()->treeView()->selectionModel()->selectedRows()) {
+    auto indexes = MainWindow::instance()->selection()->indexes();
+    ret.reserve(indexes.size());
+    for (const auto &index : indexes) {
         ret.append(engine->newQObject(new ItemObject(index)));
     }
     return engine->toScriptValue(ret);
 }
 
 void DocumentObject::clearSelection() {
-    MainWindow::instance()->treeView()->selectionModel()->clearSelection();
+    MainWindow::instance()->selection()->clear();
+}
+
+bool DocumentObject::transformSelectedTimes(const QJSValue &function) {
+    if (!function.isCallable())
+        return false;
+    TimeTransform transform(MainWindow::instance()->selection()->indexes());
+    QJSValue error;
+    transform.map([&](int time) {
+        if (!error.isUndefined())
+            return static_cast<double>(time);
+        auto ret = function.call({time});
+        if (ret.isError()) {
+            error = ret;
+        } else if (!ret.isNumber() || !std::isfinite(ret.toNumber())) {
+            error = qjsEngine(this)->newErrorObject(QJSValue::TypeError, tr("The transform function must return a finite number, but returned %1 for %2").arg(ret.toString()).arg(time));
+        }
+        return error.isUndefined() ? std::round(ret.toNumber()) : static_cast<double>(time);
+    });
+    // Rethrowing aborts the script, and with it the transaction, instead of writing 0 into the document
+    if (!error.isUndefined()) {
+        qjsEngine(this)->throwError(error);
+        return false;
+    }
+    if (!transform.isValid())
+        return false;
+    transform.commit();
+    return true;
 }
 
 QObject * DocumentObject::findItemByTime(int time) const {
@@ -23,6 +23,7 @@ public slots:
 
     QJSValue selectedItems() const;
     void clearSelection();
+    bool transformSelectedTimes(const QJSValue &function);
 
     QObject *findItemByTime(int time) const;
 
@@ -7,6 +7,8 @@
 #include <QPushButton>
 #include <QPlainTextEdit>
 #include <QMessageBox>
+#include <QLabel>
+#include <QTextStream>
 
 #include <NeoLrcEditorApp/TimeSpinBox.h>
 
@@ -26,6 +28,9 @@ ImportDialog::ImportDialog(QWidget *parent) : QDialog(parent) {
     mainLayout->addLayout(formLayout);
     m_editor = new QPlainTextEdit;
     formLayout->addRow(m_editor);
+    m_previewLabel = new QLabel;
+    m_previewLabel->setVisible(false);
+    formLayout->addRow(m_previewLabel);
     auto buttonLayout = new QHBoxLayout;
     buttonLayout->addStretch();
     auto okButton = new QPushButton(tr("OK"));
@@ -50,12 +55,26 @@ ImportDialog::ImportDialog(QWidget *parent) : QDialog(parent) {
             return;
         }
         fileNameLineEdit->setText(fileName);
-        m_editor->setPlainText(QString::fromUtf8(f.readAll()));
+        m_fileName = fileName;
+        // Only the beginning of the file is loaded here, the whole file is streamed in on import
+        QTextStream stream(&f);
+        QStringList lines;
+        QString line;
+        while (lines.size() < PreviewLineCount && stream.readLineInto(&line))
+            lines.append(line);
+        m_editor->setPlainText(lines.join('\n'));
+        m_editor->setReadOnly(true);
+        m_previewLabel->setText(tr("Showing the first %1 lines. The whole file will be imported.").arg(lines.size()));
+        m_previewLabel->setVisible(!stream.atEnd());
     });
 }
 
 ImportDialog::~ImportDialog() = default;
 
+QString ImportDialog::fileName() const {
+    return m_fileName;
+}
+
 QString ImportDialog::text() const {
     return m_editor->toPlainText();
 }
@@ -4,20 +4,26 @@
 #include <QDialog>
 
 class QPlainTextEdit;
+class QLabel;
 
 class TimeSpinBox;
 
 class ImportDialog : public QDialog {
     Q_OBJECT
 public:
+    static constexpr int PreviewLineCount = 1000;
+
     explicit ImportDialog(QWidget *parent = nullptr);
     ~ImportDialog() override;
 
+    QString fileName() const;
     QString text() const;
     int initialTime() const;
 
 private:
+    QString m_fileName;
     QPlainTextEdit *m_editor;
+    QLabel *m_previewLabel;
     TimeSpinBox *m_initialTimeSpinBox;
 };
 
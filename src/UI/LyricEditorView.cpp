@@ -1,5 +1,6 @@
 #include "LyricEditorView.h"
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
 
@@ -15,13 +16,14 @@
 #include <QHBoxLayout>
 #include <QScrollBar>
 #include <QToolTip>
-
-#include <TalcsGui/WaveformPainter.h>
+#include <QTimer>
 
 #include <NeoLrcEditorApp/LyricDocument.h>
 #include <NeoLrcEditorApp/MainWindow.h>
 #include <NeoLrcEditorApp/PlaybackController.h>
 #include <NeoLrcEditorApp/TimeValidator.h>
+#include <NeoLrcEditorApp/WaveformPeakCache.h>
+#include <NeoLrcEditorApp/WaveformTileCache.h>
 
 static LyricEditorView *m_view = nullptr;
 
@@ -64,29 +66,12 @@ public:
 
     explicit LyricLineItem(const QPersistentModelIndex &index, QGraphicsItem *parent = nullptr) : QGraphicsItem(parent), index(index) {
         setX(m_view->getItemXFromTime(time()));
-        setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemSendsScenePositionChanges);
+        setFlags(QGraphicsItem::ItemIsSelectable);
         setAcceptHoverEvents(true);
         setCursor(Qt::SizeHorCursor);
         updateBoundingRectBeforeRepaint();
     }
 
-    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override {
-        if (change == ItemPositionChange && m_timeBeforeDragging != -1) {
-            auto newPos = value.toPointF();
-            newPos.setX(qMax(newPos.x(), 0.0));
-            newPos.setY(0);
-            LyricDocument::instance()->model()->setData(index, m_view->getTimeFromItemX(x()));
-            auto affectedItem = previousItem();
-            if (affectedItem)
-                affectedItem->update();
-            affectedItem = nextItem();
-            if (affectedItem)
-                affectedItem->update();
-            return newPos;
-        }
-        return QGraphicsItem::itemChange(change, value);
-    }
-
     QRectF boundingRect() const override {
         return m_boundingRect;
     }
@@ -166,23 +151,76 @@ public:
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override {
         QGraphicsItem::mousePressEvent(event);
+        m_view->m_draggingItems.clear();
+        for (auto item : scene()->selectedItems()) {
+            if (auto lyricLineItem = dynamic_cast<LyricLineItem *>(item))
+                m_view->m_draggingItems.append({lyricLineItem, lyricLineItem->time()});
+        }
+        if (!isSelected())
+            m_view->m_draggingItems.append({this, time()});
         m_timeBeforeDragging = time();
+        m_dragOriginTime = m_view->getTimeFromItemX(event->scenePos().x());
         MainWindow::instance()->treeView()->setCurrentIndex(LyricDocument::instance()->proxyModel()->mapFromSource(index));
+        m_view->m_dragPreviewItem->setTime(m_timeBeforeDragging);
+        m_view->m_dragPreviewItem->setX(x());
+        m_view->m_dragPreviewItem->show();
         update();
     }
 
+    void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override {
+        if (m_timeBeforeDragging == -1)
+            return;
+        // All dragged lines are shifted by the same delta, which must not move any of them before zero
+        auto minimumTime = std::numeric_limits<int>::max();
+        for (const auto &[item, timeBeforeDragging] : m_view->m_draggingItems)
+            minimumTime = qMin(minimumTime, timeBeforeDragging);
+        auto delta = qMax(m_view->getTimeFromItemX(event->scenePos().x()) - m_dragOriginTime, -minimumTime);
+        for (const auto &[item, timeBeforeDragging] : m_view->m_draggingItems) {
+            item->setX(m_view->getItemXFromTime(timeBeforeDragging + delta));
+            item->update();
+            auto affectedItem = item->previousItem();
+            if (affectedItem)
+                affectedItem->update();
+        }
+        m_view->m_dragPreviewItem->setTime(m_timeBeforeDragging + delta);
+        m_view->m_dragPreviewItem->setX(x());
+        // A click that only selects the line should not pause playback, so scrubbing waits for the drag to actually move
+        if (!m_isScrubbing) {
+            PlaybackController::instance()->beginScrub();
+            m_isScrubbing = true;
+        }
+        PlaybackController::instance()->scrubTo(m_timeBeforeDragging + delta);
+    }
+
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override {
         QGraphicsItem::mouseReleaseEvent(event);
+        m_view->m_dragPreviewItem->hide();
+        if (m_isScrubbing) {
+            PlaybackController::instance()->endScrub();
+            m_isScrubbing = false;
+        }
         MainWindow::instance()->treeView()->setCurrentIndex(LyricDocument::instance()->proxyModel()->mapFromSource(index));
-        auto newTime = m_view->getTimeFromItemX(x());
-        if (newTime != m_timeBeforeDragging) {
+        QModelIndexList indexes;
+        QVariantList newTimes;
+        QVariantList oldTimes;
+        for (const auto &[item, timeBeforeDragging] : m_view->m_draggingItems) {
+            auto newTime = m_view->getTimeFromItemX(item->x());
+            if (newTime == timeBeforeDragging)
+                continue;
+            indexes.append(item->index);
+            newTimes.append(newTime);
+            oldTimes.append(timeBeforeDragging);
+        }
+        m_view->m_draggingItems.clear();
+        m_timeBeforeDragging = -1;
+        if (!indexes.isEmpty()) {
             LyricDocument::instance()->beginTransaction("Edit Time");
-            LyricDocument::instance()->pushEditCommand(index, newTime, m_timeBeforeDragging);
+            LyricDocument::instance()->pushBatchEditCommand(indexes, newTimes, oldTimes);
             LyricDocument::instance()->commitTransaction();
         }
-        m_timeBeforeDragging = -1;
         update();
     }
+
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override {
         QGraphicsItem::mouseDoubleClickEvent(event);
         EditDialog dlg;
@@ -215,6 +253,8 @@ protected:
 
 private:
     int m_timeBeforeDragging = -1;
+    int m_dragOriginTime = 0;
+    bool m_isScrubbing = false;
 };
 
 class WaveformItem : public QGraphicsItem {
@@ -222,6 +262,7 @@ public:
     QRectF m_boundingRect;
 
     explicit WaveformItem(QGraphicsItem *parent = nullptr) : QGraphicsItem(parent) {
+        setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
     }
 
     ~WaveformItem() override = default;
@@ -239,16 +280,145 @@ public:
     }
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override {
-        auto rect = boundingRect().intersected(m_view->visibleRect());
-        painter->setBrush(QColor(0xcc, 0xcc, 0xcc));
-        painter->setPen(Qt::NoPen);
-        auto startSecond = m_view->getSecondFromItemX(rect.left());
-        auto lengthSecond = m_view->getSecondFromItemX(rect.width());
-        PlaybackController::instance()->waveformPainter()->paint(painter, rect.toRect(), startSecond, lengthSecond);
+        auto visibleRect = boundingRect().intersected(m_view->visibleRect());
+        auto rect = visibleRect.intersected(option->exposedRect);
+        if (!rect.isEmpty()) {
+            auto height = static_cast<int>(std::ceil(visibleRect.height()));
+            auto firstTile = static_cast<qint64>(std::floor(rect.left() / WaveformTileCache::TileWidth));
+            auto lastTile = static_cast<qint64>(std::ceil(rect.right() / WaveformTileCache::TileWidth));
+            painter->save();
+            painter->setClipRect(visibleRect);
+            for (auto index = firstTile; index < lastTile; index++) {
+                auto image = m_view->m_waveformTileCache->tile(m_view->m_scaleRate, index, height);
+                if (!image.isNull())
+                    painter->drawImage(QPointF(static_cast<double>(index * WaveformTileCache::TileWidth), visibleRect.top()), image);
+            }
+            painter->restore();
+        }
         updateBoundingRectAfterRepaint();
     }
 };
 
+class LyricClusterItem : public QGraphicsItem {
+public:
+    // Clusters at level n group the lines whose times fall into the same 2^n centisecond bucket
+    struct Cluster {
+        qint64 bucket;
+        int count;
+        int firstTime;
+    };
+
+    static constexpr double ClusterWidth = 8.0;
+
+    QRectF m_boundingRect;
+
+    explicit LyricClusterItem(QGraphicsItem *parent = nullptr) : QGraphicsItem(parent) {
+        setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    }
+
+    ~LyricClusterItem() override = default;
+
+    void rebuild(QList<int> times) {
+        std::sort(times.begin(), times.end());
+        m_levels.clear();
+        QList<Cluster> clusters;
+        for (auto time : times) {
+            if (!clusters.isEmpty() && clusters.last().bucket == time)
+                clusters.last().count++;
+            else
+                clusters.append({time, 1, time});
+        }
+        m_levels.append(clusters);
+        while (m_levels.last().size() > 1) {
+            QList<Cluster> parents;
+            for (const auto &child : m_levels.last()) {
+                auto bucket = child.bucket >> 1;
+                if (!parents.isEmpty() && parents.last().bucket == bucket)
+                    parents.last().count += child.count;
+                else
+                    parents.append({bucket, child.count, child.firstTime});
+            }
+            m_levels.append(parents);
+        }
+        update();
+    }
+
+    void setBoundingRect(const QRectF &rect) {
+        prepareGeometryChange();
+        m_boundingRect = rect;
+    }
+
+    QRectF boundingRect() const override {
+        return m_boundingRect;
+    }
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override {
+        if (m_levels.isEmpty() || m_levels.first().isEmpty())
+            return;
+        auto level = qBound(0, static_cast<int>(std::ceil(std::log2(ClusterWidth / m_view->getItemXFromTime(1)))), static_cast<int>(m_levels.size()) - 1);
+        const auto &clusters = m_levels[level];
+        auto rect = m_view->visibleRect().intersected(option->exposedRect);
+        auto firstBucket = static_cast<qint64>(qMax(0, m_view->getTimeFromItemX(rect.left() - ClusterWidth))) >> level;
+        auto lastTime = m_view->getTimeFromItemX(rect.right());
+        auto height = m_view->visibleRect().height();
+
+        painter->setBrush(QColor(0x42, 0x63, 0xeb));
+        painter->setPen(Qt::NoPen);
+        auto it = std::lower_bound(clusters.cbegin(), clusters.cend(), firstBucket, [](const Cluster &cluster, qint64 bucket) {
+            return cluster.bucket < bucket;
+        });
+        for (auto clusterIt = it; clusterIt != clusters.cend() && clusterIt->firstTime <= lastTime; clusterIt++) {
+            painter->drawRect(QRectF(m_view->getItemXFromTime(clusterIt->firstTime), 0, 2, height));
+        }
+        painter->setPen(Qt::white);
+        auto fontMetrics = painter->fontMetrics();
+        for (auto clusterIt = it; clusterIt != clusters.cend() && clusterIt->firstTime <= lastTime; clusterIt++) {
+            if (clusterIt->count == 1)
+                continue;
+            auto text = QString::number(clusterIt->count);
+            QRectF badgeRect(m_view->getItemXFromTime(clusterIt->firstTime), 0, fontMetrics.horizontalAdvance(text) + 6.0, fontMetrics.height() + 2.0);
+            painter->fillRect(badgeRect, QColor(0x42, 0x63, 0xeb));
+            painter->drawText(badgeRect, Qt::AlignCenter, text);
+        }
+    }
+
+private:
+    QList<QList<Cluster>> m_levels;
+};
+
+class DragPreviewItem : public QGraphicsItem {
+public:
+    explicit DragPreviewItem(QGraphicsItem *parent = nullptr) : QGraphicsItem(parent) {
+    }
+
+    ~DragPreviewItem() override = default;
+
+    void setTime(int time) {
+        if (m_time == time)
+            return;
+        m_time = time;
+        // The bounding rect follows the width of the text
+        prepareGeometryChange();
+        m_text = TimeValidator::timeToString(time);
+    }
+
+    QRectF boundingRect() const override {
+        return {0, 0, QFontMetrics(QFont()).horizontalAdvance(m_text) + 8.0, QFontMetrics(QFont()).height() + 4.0};
+    }
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override {
+        painter->setBrush(QColor(0x42, 0x63, 0xeb));
+        painter->setPen(Qt::NoPen);
+        painter->drawRect(boundingRect());
+        painter->setPen(Qt::white);
+        painter->drawText(boundingRect(), Qt::AlignCenter, m_text);
+    }
+
+private:
+    int m_time = -1;
+    QString m_text;
+};
+
 class PlayheadItem : public QGraphicsItem {
 public:
     explicit PlayheadItem(QGraphicsItem *parent = nullptr) : QGraphicsItem(parent) {
@@ -276,7 +446,9 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     verticalScrollBar()->setEnabled(false);
     setMouseTracking(true);
+    setDragMode(QGraphicsView::RubberBandDrag);
 
+    m_waveformTileCache = new WaveformTileCache(PlaybackController::instance()->waveformPeakCache(), this);
     m_waveformItem = new WaveformItem;
     m_scene->addItem(m_waveformItem);
 
@@ -284,11 +456,17 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
     m_playheadItem->setZValue(1);
     m_scene->addItem(m_playheadItem);
 
-    connect(m_scene, &QGraphicsScene::changed, this, [=] {
-        QRectF rect = m_scene->itemsBoundingRect();
-        m_scene->setSceneRect(rect);
-    });
+    m_dragPreviewItem = new DragPreviewItem;
+    m_dragPreviewItem->setZValue(2);
+    m_dragPreviewItem->hide();
+    m_scene->addItem(m_dragPreviewItem);
 
+    m_clusterItem = new LyricClusterItem;
+    m_clusterItem->hide();
+    m_scene->addItem(m_clusterItem);
+    m_clusterRebuildTimer = new QTimer(this);
+    m_clusterRebuildTimer->setSingleShot(true);
+    connect(m_clusterRebuildTimer, &QTimer::timeout, this, &LyricEditorView::rebuildClusters);
 
     auto model = LyricDocument::instance()->model();
 
@@ -296,6 +474,7 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
         for (int row = first; row <= last; row++) {
             auto index = model->index(row, 0);
             auto item = new LyricLineItem(index);
+            item->setVisible(!m_isClustered);
             m_itemDict.insert(index, item);
             m_scene->addItem(item);
 
@@ -303,6 +482,8 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
             if (affectedItem)
                 affectedItem->update();
         }
+        updateSceneRect();
+        m_clusterRebuildTimer->start();
     });
     connect(model, &QStandardItemModel::dataChanged, this, [=](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
         for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
@@ -315,6 +496,8 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
             if (affectedItem)
                 affectedItem->update();
         }
+        updateSceneRect();
+        m_clusterRebuildTimer->start();
     });
     connect(model, &QStandardItemModel::rowsAboutToBeRemoved, this, [=](const QModelIndex &, int first, int last) {
         for (int row = first; row <= last; row++) {
@@ -328,26 +511,50 @@ LyricEditorView::LyricEditorView(QWidget *parent) : QGraphicsView(parent) {
             delete item;
         }
     });
+    connect(model, &QStandardItemModel::rowsRemoved, this, [=] {
+        updateSceneRect();
+        m_clusterRebuildTimer->start();
+    });
     connect(model, &QStandardItemModel::modelAboutToBeReset, this, [=] {
         for (auto item : m_itemDict.values()) {
             m_scene->removeItem(item);
         }
         m_itemDict.clear();
     });
+    connect(model, &QStandardItemModel::modelReset, this, [=] {
+        updateSceneRect();
+        m_clusterRebuildTimer->start();
+    });
+    connect(PlaybackController::instance(), &PlaybackController::audioFileNameChanged, this, &LyricEditorView::updateSceneRect);
 
-    connect(PlaybackController::instance()->waveformPainter(), &talcs::WaveformPainter::loadFinished, this, [=] {
+    connect(PlaybackController::instance()->waveformPeakCache(), &WaveformPeakCache::chunkLoaded, this, [=](double startSecond, double lengthSecond) {
+        // Coarse levels merge neighbouring chunks, so a finished chunk may also change the adjacent pixels
+        m_waveformTileCache->invalidate(startSecond, lengthSecond);
+        m_waveformItem->updateBoundingRectBeforeRepaint();
+        m_waveformItem->update(QRectF(getItemXFromSecond(startSecond) - 2.0, 0, getItemXFromSecond(lengthSecond) + 4.0, visibleRect().height()));
+    });
+    connect(PlaybackController::instance()->waveformPeakCache(), &WaveformPeakCache::loadFinished, this, [=] {
+        m_waveformTileCache->invalidate();
         m_waveformItem->updateBoundingRectBeforeRepaint();
         m_waveformItem->update();
+        updateSceneRect();
+    });
+    connect(m_waveformTileCache, &WaveformTileCache::tileReady, this, [=](double scaleRate, qint64 index) {
+        if (scaleRate == m_scaleRate)
+            m_waveformItem->update(QRectF(static_cast<double>(index * WaveformTileCache::TileWidth), 0, WaveformTileCache::TileWidth, visibleRect().height()));
     });
+    connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &LyricEditorView::updateVisibleRange);
+    connect(horizontalScrollBar(), &QScrollBar::rangeChanged, this, &LyricEditorView::updateVisibleRange);
 
-    connect(PlaybackController::instance(), &PlaybackController::positionTimeChanged, this, [=](int time) {
-        m_playheadItem->setX(getItemXFromTime(time));
+    connect(PlaybackController::instance(), &PlaybackController::playheadPositionChanged, this, [=](double second) {
+        m_playheadItem->setX(getItemXFromSecond(second));
         auto rect = visibleRect();
         if (rect.right() - m_playheadItem->x() <= 50) {
             centerOn(m_playheadItem->x() + rect.width() / 2 - 50, rect.center().y());
         } else if (m_playheadItem->x() - rect.left() < 50) {
             centerOn(m_playheadItem->x() - rect.width() / 2 + 50, rect.center().y());
         }
+        updateWaveformLoadingPriority();
     });
 }
 
@@ -404,11 +611,67 @@ void LyricEditorView::mouseMoveEvent(QMouseEvent *event) {
     QGraphicsView::mouseMoveEvent(event);
 }
 
+void LyricEditorView::resizeEvent(QResizeEvent *event) {
+    QGraphicsView::resizeEvent(event);
+    updateSceneRect();
+    updateVisibleRange();
+}
+
 void LyricEditorView::updateItemPositionAfterScaling() {
-    for (auto item : m_itemDict.values()) {
-        item->setX(getItemXFromTime(item->time()));
+    auto isClustered = m_scaleRate < ClusteringScaleRate;
+    if (isClustered != m_isClustered) {
+        m_isClustered = isClustered;
+        for (auto item : m_itemDict.values())
+            item->setVisible(!isClustered);
+        m_clusterItem->setVisible(isClustered);
+        if (isClustered)
+            rebuildClusters();
+    }
+    // Hidden items are repositioned when clustering is turned off again
+    if (!m_isClustered) {
+        for (auto item : m_itemDict.values()) {
+            item->setX(getItemXFromTime(item->time()));
+        }
     }
+    m_clusterItem->update();
     m_waveformItem->updateBoundingRectBeforeRepaint();
     m_waveformItem->update();
-    m_playheadItem->setX(getItemXFromTime(PlaybackController::instance()->positionTime()));
+    m_playheadItem->setX(getItemXFromSecond(PlaybackController::instance()->positionSecond()));
+    updateSceneRect();
+    updateVisibleRange();
+}
+
+void LyricEditorView::updateSceneRect() {
+    // Computed from the document and audio extents instead of itemsBoundingRect(), which visits every item
+    auto proxyModel = LyricDocument::instance()->proxyModel();
+    auto lastTime = proxyModel->rowCount() ? proxyModel->data(proxyModel->index(proxyModel->rowCount() - 1, 0)).toInt() : 0;
+    auto width = qMax(getItemXFromTime(PlaybackController::instance()->audioLengthTime()), getItemXFromTime(lastTime) + viewport()->width() / 2.0);
+    m_scene->setSceneRect(0, 0, width, qMax(1, viewport()->height()));
+    m_clusterItem->setBoundingRect(m_scene->sceneRect());
+}
+
+void LyricEditorView::rebuildClusters() {
+    if (!m_isClustered)
+        return;
+    auto model = LyricDocument::instance()->model();
+    QList<int> times;
+    times.reserve(model->rowCount());
+    for (int row = 0; row < model->rowCount(); row++)
+        times.append(model->data(model->index(row, 0)).toInt());
+    m_clusterItem->rebuild(times);
+}
+
+void LyricEditorView::centerOnSecond(double second) {
+    centerOn(getItemXFromSecond(second), visibleRect().center().y());
+}
+
+void LyricEditorView::updateVisibleRange() {
+    auto rect = visibleRect();
+    emit visibleRangeChanged(getSecondFromItemX(rect.left()), getSecondFromItemX(rect.right()));
+    updateWaveformLoadingPriority();
+}
+
+void LyricEditorView::updateWaveformLoadingPriority() {
+    auto rect = visibleRect();
+    PlaybackController::instance()->waveformPeakCache()->setPriorityRegion(getSecondFromItemX(rect.left()), getSecondFromItemX(rect.right()), PlaybackController::instance()->positionTime() / 100.0);
 }
@@ -3,12 +3,19 @@
 
 #include <QGraphicsView>
 
+class QTimer;
+
 class LyricLineItem;
 class WaveformItem;
+class WaveformTileCache;
+class DragPreviewItem;
+class LyricClusterItem;
 
 class LyricEditorView : public QGraphicsView {
     Q_OBJECT
     friend class LyricLineItem;
+    friend class WaveformItem;
+    friend class LyricClusterItem;
 public:
     explicit LyricEditorView(QWidget *parent = nullptr);
     ~LyricEditorView() override;
@@ -20,19 +27,38 @@ public:
 
     QRectF visibleRect() const;
 
+    void centerOnSecond(double second);
+
+signals:
+    void visibleRangeChanged(double startSecond, double endSecond);
+
 protected:
     void wheelEvent(QWheelEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private:
     QGraphicsScene *m_scene;
     QHash<QPersistentModelIndex, LyricLineItem *> m_itemDict;
+    QList<QPair<LyricLineItem *, int>> m_draggingItems;
     QGraphicsItem *m_playheadItem;
+    DragPreviewItem *m_dragPreviewItem;
+    LyricClusterItem *m_clusterItem;
+    QTimer *m_clusterRebuildTimer;
     WaveformItem *m_waveformItem;
+    WaveformTileCache *m_waveformTileCache;
+
+    // Below this zoom, lines closer than a few pixels are painted as one cluster marker
+    static constexpr double ClusteringScaleRate = -4.0;
 
     double m_scaleRate = 0;
+    bool m_isClustered = false;
 
     void updateItemPositionAfterScaling();
+    void updateVisibleRange();
+    void updateWaveformLoadingPriority();
+    void updateSceneRect();
+    void rebuildClusters();
 };
 
 
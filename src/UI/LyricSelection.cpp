@@ -0,0 +1,92 @@
+#include "LyricSelection.h"
+
+#include <algorithm>
+
+#include <QItemSelectionModel>
+
+LyricSelection::LyricSelection(QItemSelectionModel *selectionModel, QObject *parent) : QObject(parent), m_selectionModel(selectionModel) {
+    auto invalidate = [=] {
+        m_isDirty = true;
+    };
+    connect(selectionModel, &QItemSelectionModel::selectionChanged, this, invalidate);
+    connect(selectionModel, &QItemSelectionModel::modelChanged, this, invalidate);
+    auto model = selectionModel->model();
+    connect(model, &QAbstractItemModel::layoutChanged, this, invalidate);
+    connect(model, &QAbstractItemModel::rowsInserted, this, invalidate);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, invalidate);
+    connect(model, &QAbstractItemModel::rowsMoved, this, invalidate);
+    connect(model, &QAbstractItemModel::modelReset, this, invalidate);
+}
+
+LyricSelection::~LyricSelection() = default;
+
+QItemSelectionModel *LyricSelection::selectionModel() const {
+    return m_selectionModel;
+}
+
+QList<LyricSelection::Range> LyricSelection::ranges() const {
+    updateRanges();
+    return m_ranges;
+}
+
+bool LyricSelection::hasSelection() const {
+    updateRanges();
+    return !m_ranges.isEmpty();
+}
+
+int LyricSelection::count() const {
+    updateRanges();
+    int ret = 0;
+    for (const auto &range : m_ranges)
+        ret += range.size();
+    return ret;
+}
+
+QModelIndexList LyricSelection::indexes() const {
+    updateRanges();
+    auto model = m_selectionModel->model();
+    QModelIndexList ret;
+    ret.reserve(count());
+    for (const auto &range : m_ranges) {
+        for (int row = range.first; row <= range.last; row++)
+            ret.append(model->index(row, 0));
+    }
+    return ret;
+}
+
+void LyricSelection::selectAll() {
+    auto model = m_selectionModel->model();
+    if (!model->rowCount()) {
+        clear();
+        return;
+    }
+    m_selectionModel->select(QItemSelection(model->index(0, 0), model->index(model->rowCount() - 1, model->columnCount() - 1)), QItemSelectionModel::ClearAndSelect);
+}
+
+void LyricSelection::clear() {
+    m_selectionModel->clearSelection();
+}
+
+void LyricSelection::updateRanges() const {
+    if (!m_isDirty)
+        return;
+    m_isDirty = false;
+    m_ranges.clear();
+    for (const auto &selectionRange : m_selectionModel->selection()) {
+        if (selectionRange.isValid())
+            m_ranges.append({selectionRange.top(), selectionRange.bottom()});
+    }
+    // Ranges of different columns or from separate clicks may overlap or touch
+    std::sort(m_ranges.begin(), m_ranges.end(), [](const Range &a, const Range &b) {
+        return a.first < b.first;
+    });
+    qsizetype mergedCount = 0;
+    for (qsizetype i = 0; i < m_ranges.size(); i++) {
+        auto range = m_ranges[i];
+        if (mergedCount && range.first <= m_ranges[mergedCount - 1].last + 1)
+            m_ranges[mergedCount - 1].last = std::max(m_ranges[mergedCount - 1].last, range.last);
+        else
+            m_ranges[mergedCount++] = range;
+    }
+    m_ranges.resize(mergedCount);
+}
@@ -0,0 +1,44 @@
+#ifndef NEOLRCEDITORAPP_LYRICSELECTION_H
+#define NEOLRCEDITORAPP_LYRICSELECTION_H
+
+#include <QObject>
+#include <QModelIndexList>
+
+class QItemSelectionModel;
+
+class LyricSelection : public QObject {
+    Q_OBJECT
+public:
+    struct Range {
+        int first;
+        int last;
+
+        int size() const {
+            return last - first + 1;
+        }
+    };
+
+    explicit LyricSelection(QItemSelectionModel *selectionModel, QObject *parent = nullptr);
+    ~LyricSelection() override;
+
+    QItemSelectionModel *selectionModel() const;
+
+    QList<Range> ranges() const;
+    bool hasSelection() const;
+    int count() const;
+    QModelIndexList indexes() const;
+
+    void selectAll();
+    void clear();
+
+private:
+    void updateRanges() const;
+
+    QItemSelectionModel *m_selectionModel;
+    // Sorted, non-overlapping row ranges of the proxy model
+    mutable QList<Range> m_ranges;
+    mutable bool m_isDirty = true;
+};
+
+
+#endif //NEOLRCEDITORAPP_LYRICSELECTION_H
@@ -0,0 +1,147 @@
+#include "LyricTableView.h"
+
+#include <QHash>
+#include <QHeaderView>
+#include <QLineEdit>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStyledItemDelegate>
+
+#include <NeoLrcEditorApp/LyricDocument.h>
+#include <NeoLrcEditorApp/TimeSpinBox.h>
+#include <NeoLrcEditorApp/TimeValidator.h>
+
+class TreeViewEditTimeDelegate : public QStyledItemDelegate {
+public:
+    explicit TreeViewEditTimeDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {
+    }
+
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override {
+        return new TimeSpinBox(parent);
+    }
+
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override {
+        QVariant value = index.model()->data(index, Qt::EditRole);
+        auto timeSpinBox = static_cast<TimeSpinBox *>(editor);
+        timeSpinBox->setValue(value.toInt());
+    }
+
+    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override {
+        auto timeSpinBox = static_cast<TimeSpinBox *>(editor);
+        auto data = timeSpinBox->value();
+        // Determine whether inserted or modified, see MainWindow::insertAction()
+        if (model->data(index, Qt::UserRole).isNull())
+            LyricDocument::instance()->beginTransaction(tr("Edit Time"));
+        LyricDocument::instance()->pushEditCommand(index, data);
+        LyricDocument::instance()->commitTransaction();
+    }
+
+    QString displayText(const QVariant &value, const QLocale &locale) const override {
+        auto time = value.toInt();
+        auto it = m_timeStringCache.constFind(time);
+        if (it != m_timeStringCache.cend())
+            return it.value();
+        if (m_timeStringCache.size() >= MaximumTimeStringCacheSize)
+            m_timeStringCache.clear();
+        return m_timeStringCache.insert(time, TimeValidator::timeToString(time)).value();
+    }
+
+private:
+    static constexpr qsizetype MaximumTimeStringCacheSize = 1 << 16;
+    mutable QHash<int, QString> m_timeStringCache;
+};
+
+class TreeViewEditLyricDelegate : public QStyledItemDelegate {
+public:
+    explicit TreeViewEditLyricDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {
+    }
+
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override {
+        static TimeValidator validator;
+        auto lineEdit = new QLineEdit(parent);
+        return lineEdit;
+    }
+
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override {
+        QVariant value = index.model()->data(index, Qt::EditRole);
+        auto lineEdit = static_cast<QLineEdit *>(editor);
+        lineEdit->setText(value.toString());
+    }
+
+    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override {
+        auto lineEdit = static_cast<QLineEdit *>(editor);
+        auto data = lineEdit->text();
+        LyricDocument::instance()->beginTransaction(tr("Edit Lyric"));
+        LyricDocument::instance()->pushEditCommand(index, data);
+        LyricDocument::instance()->commitTransaction();
+    }
+};
+
+LyricTableView::LyricTableView(QWidget *parent) : QTreeView(parent) {
+    // Rows are never nested and all have the same height, so only the visible rows are laid out and painted
+    setUniformRowHeights(true);
+    setRootIsDecorated(false);
+    setItemsExpandable(false);
+    setExpandsOnDoubleClick(false);
+    setAllColumnsShowFocus(true);
+    setVerticalScrollMode(ScrollPerItem);
+    setSelectionBehavior(SelectRows);
+    setSelectionMode(ExtendedSelection);
+    setItemDelegateForColumn(0, new TreeViewEditTimeDelegate(this));
+    setItemDelegateForColumn(1, new TreeViewEditLyricDelegate(this));
+    header()->setStretchLastSection(true);
+    header()->setMinimumSectionSize(fontMetrics().horizontalAdvance(TimeValidator::timeToString(0)) + 24);
+}
+
+LyricTableView::~LyricTableView() = default;
+
+void LyricTableView::setPlayingRow(int row) {
+    if (row == m_playingRow)
+        return;
+    auto previousRow = m_playingRow;
+    m_playingRow = row;
+    updateRow(previousRow);
+    updateRow(row);
+    if (m_isFollowingPlayback && row != -1) {
+        auto topRow = verticalScrollBar()->value();
+        if (row < topRow || row >= topRow + verticalScrollBar()->pageStep())
+            scrollToRow(row);
+    }
+}
+
+int LyricTableView::playingRow() const {
+    return m_playingRow;
+}
+
+void LyricTableView::setFollowingPlayback(bool isFollowingPlayback) {
+    m_isFollowingPlayback = isFollowingPlayback;
+    if (isFollowingPlayback && m_playingRow != -1)
+        scrollToRow(m_playingRow);
+}
+
+bool LyricTableView::isFollowingPlayback() const {
+    return m_isFollowingPlayback;
+}
+
+void LyricTableView::drawRow(QPainter *painter, const QStyleOptionViewItem &options, const QModelIndex &index) const {
+    // The playing row is an overlay of the view, the model is never touched
+    if (index.row() == m_playingRow) {
+        auto color = palette().color(QPalette::Highlight);
+        color.setAlpha(0x3f);
+        painter->fillRect(options.rect, color);
+    }
+    QTreeView::drawRow(painter, options, index);
+}
+
+void LyricTableView::scrollToRow(int row) {
+    // In per-item scroll mode the scroll bar value is the top row and the page step is the number of visible rows
+    verticalScrollBar()->setValue(row - verticalScrollBar()->pageStep() / 2);
+}
+
+void LyricTableView::updateRow(int row) {
+    if (row == -1 || !model() || row >= model()->rowCount())
+        return;
+    auto rect = visualRect(model()->index(row, 0));
+    if (rect.isValid())
+        viewport()->update(0, rect.y(), viewport()->width(), rect.height());
+}
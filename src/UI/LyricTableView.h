@@ -0,0 +1,30 @@
+#ifndef NEOLRCEDITORAPP_LYRICTABLEVIEW_H
+#define NEOLRCEDITORAPP_LYRICTABLEVIEW_H
+
+#include <QTreeView>
+
+class LyricTableView : public QTreeView {
+    Q_OBJECT
+public:
+    explicit LyricTableView(QWidget *parent = nullptr);
+    ~LyricTableView() override;
+
+    void setPlayingRow(int row);
+    int playingRow() const;
+
+    void setFollowingPlayback(bool isFollowingPlayback);
+    bool isFollowingPlayback() const;
+
+protected:
+    void drawRow(QPainter *painter, const QStyleOptionViewItem &options, const QModelIndex &index) const override;
+
+private:
+    void scrollToRow(int row);
+    void updateRow(int row);
+
+    int m_playingRow = -1;
+    bool m_isFollowingPlayback = false;
+};
+
+
+#endif //NEOLRCEDITORAPP_LYRICTABLEVIEW_H
@@ -1,6 +1,7 @@
 #include "MainWindow.h"
 
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <set>
 
@@ -11,8 +12,7 @@
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
-#include <QLineEdit>
-#include <QStyledItemDelegate>
+#include <QActionGroup>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QApplication>
@@ -23,115 +23,130 @@
 #include <QTimer>
 #include <QSortFilterProxyModel>
 #include <QLabel>
+#include <QDoubleSpinBox>
+#include <QPainter>
+#include <QStaticText>
 #include <QStandardPaths>
 #include <QDir>
 #include <QDesktopServices>
 #include <QJSEngine>
+#include <QLoggingCategory>
+#include <QProgressDialog>
+#include <QTextStream>
 
 #include <TalcsFormat/AudioFormatIO.h>
 
 #include <NeoLrcEditorApp/LyricEditorView.h>
+#include <NeoLrcEditorApp/LyricSelection.h>
+#include <NeoLrcEditorApp/LyricTableView.h>
+#include <NeoLrcEditorApp/TapRecorder.h>
+#include <NeoLrcEditorApp/OverviewStrip.h>
 #include <NeoLrcEditorApp/TimeValidator.h>
+#include <NeoLrcEditorApp/TimeTransform.h>
 #include <NeoLrcEditorApp/LyricDocument.h>
+#include <NeoLrcEditorApp/LyricLine.h>
 #include <NeoLrcEditorApp/PlaybackController.h>
 #include <NeoLrcEditorApp/QuantizeDialog.h>
-#include <NeoLrcEditorApp/TimeSpinBox.h>
 #include <NeoLrcEditorApp/AdjustTimeDialog.h>
 #include <NeoLrcEditorApp/ImportDialog.h>
 #include <NeoLrcEditorApp/DocumentObject.h>
 
 static MainWindow *m_instance = nullptr;
 
-class TreeViewEditTimeDelegate : public QStyledItemDelegate {
-public:
-    explicit TreeViewEditTimeDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {
-    }
+Q_LOGGING_CATEGORY(lcStartup, "neolrceditor.startup", QtWarningMsg)
 
-    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override {
-        return new TimeSpinBox(parent);
+class CurrentLyricLabel : public QWidget {
+public:
+    explicit CurrentLyricLabel(QWidget *parent = nullptr) : QWidget(parent) {
+        m_staticText.setTextFormat(Qt::PlainText);
+        m_staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+        setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
     }
 
-    void setEditorData(QWidget *editor, const QModelIndex &index) const override {
-        QVariant value = index.model()->data(index, Qt::EditRole);
-        auto timeSpinBox = static_cast<TimeSpinBox *>(editor);
-        timeSpinBox->setValue(value.toInt());
+    void setRow(int row) {
+        m_row = row;
+        auto text = row == -1 ? QString() : LyricDocument::instance()->proxyModel()->data(LyricDocument::instance()->proxyModel()->index(row, 1)).toString();
+        if (text == m_staticText.text())
+            return;
+        m_staticText.setText(text);
+        m_staticText.prepare({}, font());
+        update();
     }
 
-    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override {
-        auto timeSpinBox = static_cast<TimeSpinBox *>(editor);
-        auto data = timeSpinBox->value();
-        // Determine whether inserted or modified, see MainWindow::insertAction()
-        if (model->data(index, Qt::UserRole).isNull())
-            LyricDocument::instance()->beginTransaction(tr("Edit Time"));
-        LyricDocument::instance()->pushEditCommand(index, data);
-        LyricDocument::instance()->commitTransaction();
-    }
+    int m_row = -1;
 
-    QString displayText(const QVariant &value, const QLocale &locale) const override {
-        return TimeValidator::timeToString(value.toInt());
+    QSize sizeHint() const override {
+        return {0, fontMetrics().height()};
     }
-};
 
-class TreeViewEditLyricDelegate : public QStyledItemDelegate {
-public:
-    explicit TreeViewEditLyricDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {
+protected:
+    void paintEvent(QPaintEvent *event) override {
+        if (m_staticText.text().isEmpty())
+            return;
+        QPainter painter(this);
+        painter.setFont(font());
+        painter.setPen(palette().color(QPalette::WindowText));
+        painter.drawStaticText(QPointF(0, (height() - m_staticText.size().height()) / 2), m_staticText);
     }
 
-    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override {
-        static TimeValidator validator;
-        auto lineEdit = new QLineEdit(parent);
-        return lineEdit;
+    void changeEvent(QEvent *event) override {
+        if (event->type() == QEvent::FontChange) {
+            m_staticText.prepare({}, font());
+            updateGeometry();
+        }
+        QWidget::changeEvent(event);
     }
 
-    void setEditorData(QWidget *editor, const QModelIndex &index) const override {
-        QVariant value = index.model()->data(index, Qt::EditRole);
-        auto lineEdit = static_cast<QLineEdit *>(editor);
-        lineEdit->setText(value.toString());
+    void mousePressEvent(QMouseEvent *ev) override {
+        if (m_row != -1)
+            m_instance->treeView()->setCurrentIndex(LyricDocument::instance()->proxyModel()->index(m_row, 0));
     }
 
-    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override {
-        auto lineEdit = static_cast<QLineEdit *>(editor);
-        auto data = lineEdit->text();
-        LyricDocument::instance()->beginTransaction(tr("Edit Lyric"));
-        LyricDocument::instance()->pushEditCommand(index, data);
-        LyricDocument::instance()->commitTransaction();
-    }
+private:
+    QStaticText m_staticText;
 };
 
-class CurrentLyricLabel : public QLabel {
+class LyricPreviewTracker : public QObject {
 public:
-    explicit CurrentLyricLabel(QWidget *parent = nullptr) : QLabel(parent) {
+    LyricPreviewTracker(CurrentLyricLabel *previousLyricLabel, CurrentLyricLabel *currentLyricLabel, CurrentLyricLabel *nextLyricLabel, LyricTableView *tableView, QObject *parent = nullptr)
+        : QObject(parent), m_previousLyricLabel(previousLyricLabel), m_currentLyricLabel(currentLyricLabel), m_nextLyricLabel(nextLyricLabel), m_tableView(tableView) {
     }
 
-    void updateText() {
-        if (m_row == -1)
-            setText({});
-        else
-            setText(LyricDocument::instance()->proxyModel()->data(LyricDocument::instance()->proxyModel()->index(m_row, 1)).toString());
+    void setTime(int time) {
+        // The current row stays the same while time is in (lower, upper]
+        if (m_lowerBoundary < time && time <= m_upperBoundary)
+            return;
+        refresh(time);
     }
 
-    void setRow(int row) {
-        m_row = row;
-        updateText();
+    void refresh(int time) {
+        auto proxyModel = LyricDocument::instance()->proxyModel();
+        auto currentRow = LyricDocument::instance()->findRowByTime(time);
+        m_lowerBoundary = currentRow == -1 ? std::numeric_limits<int>::min() : proxyModel->data(proxyModel->index(currentRow, 0)).toInt();
+        m_upperBoundary = currentRow + 1 < proxyModel->rowCount() ? proxyModel->data(proxyModel->index(currentRow + 1, 0)).toInt() : std::numeric_limits<int>::max();
+        m_previousLyricLabel->setRow(qMax(-1, currentRow - 1));
+        m_currentLyricLabel->setRow(currentRow);
+        m_nextLyricLabel->setRow(currentRow + 1 < proxyModel->rowCount() ? currentRow + 1 : -1);
+        m_tableView->setPlayingRow(currentRow);
     }
 
-    int m_row = -1;
-
-protected:
-    void mousePressEvent(QMouseEvent *ev) override {
-        if (m_row != -1)
-            m_instance->treeView()->setCurrentIndex(LyricDocument::instance()->proxyModel()->index(m_row, 0));
-    }
+private:
+    CurrentLyricLabel *m_previousLyricLabel;
+    CurrentLyricLabel *m_currentLyricLabel;
+    CurrentLyricLabel *m_nextLyricLabel;
+    LyricTableView *m_tableView;
+    int m_lowerBoundary = 0;
+    int m_upperBoundary = -1;
 };
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     m_instance = this;
+    m_startupTimer.start();
 
+    // The audio device is started in deferredInitialize()
     auto playbackController = new PlaybackController(this);
-    if (!playbackController->initialize())
-        QMessageBox::critical(this, {}, tr("Cannot initialize audio"));
-
     m_document = new LyricDocument(this);
+    recordStartupPhase("playback and document");
 
     auto mainWidget = new QWidget;
     auto mainLayout = new QVBoxLayout;
@@ -142,14 +157,10 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     auto upperAreaSplitter = new QSplitter;
     upperAreaSplitter->setOrientation(Qt::Horizontal);
 
-    m_treeView = new QTreeView;
-    m_treeView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    m_treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    auto timeDelegate = new TreeViewEditTimeDelegate(m_treeView);
-    m_treeView->setItemDelegateForColumn(0, timeDelegate);
-    m_treeView->setItemDelegateForColumn(1, new TreeViewEditLyricDelegate(m_treeView));
+    m_treeView = new LyricTableView;
     m_treeView->setModel(m_document->proxyModel());
     m_selectionModel = m_treeView->selectionModel();
+    m_selection = new LyricSelection(m_selectionModel, this);
     upperAreaSplitter->addWidget(m_treeView);
 
     auto lyricPreviewWidget = new QWidget;
@@ -162,8 +173,18 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     splitter->setSizes(QList<int>({std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}));
 
 
+    auto lyricEditorWidget = new QWidget;
+    auto lyricEditorLayout = new QVBoxLayout;
+    lyricEditorLayout->setContentsMargins(0, 0, 0, 0);
+    lyricEditorLayout->setSpacing(0);
     m_lyricEditorView = new LyricEditorView;
-    splitter->addWidget(m_lyricEditorView);
+    lyricEditorLayout->addWidget(m_lyricEditorView);
+    auto overviewStrip = new OverviewStrip;
+    lyricEditorLayout->addWidget(overviewStrip);
+    lyricEditorWidget->setLayout(lyricEditorLayout);
+    splitter->addWidget(lyricEditorWidget);
+    connect(m_lyricEditorView, &LyricEditorView::visibleRangeChanged, overviewStrip, &OverviewStrip::setVisibleRange);
+    connect(overviewStrip, &OverviewStrip::viewportMoveRequested, m_lyricEditorView, &LyricEditorView::centerOnSecond);
 
     mainLayout->addWidget(splitter);
 
@@ -176,6 +197,13 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     playbackTransportLayout->addWidget(timeSlider);
     auto totalTimeLabel = new QLabel(TimeValidator::timeToString(0));
     playbackTransportLayout->addWidget(totalTimeLabel);
+    auto playbackRateSpinBox = new QDoubleSpinBox;
+    playbackRateSpinBox->setRange(0.5, 1.5);
+    playbackRateSpinBox->setSingleStep(0.05);
+    playbackRateSpinBox->setSuffix("x");
+    playbackRateSpinBox->setValue(1.0);
+    playbackRateSpinBox->setToolTip(tr("Playback speed"));
+    playbackTransportLayout->addWidget(playbackRateSpinBox);
     mainLayout->addLayout(playbackTransportLayout);
 
     auto playbackToolBar = new QToolBar;
@@ -254,6 +282,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     auto setTimeAndNextAction = editMenu->addAction(tr("Set Time and Next"), Qt::Key_F9, this, &MainWindow::setTimeAndNextAction);
     editMenu->addAction(tr("Insert Empty Line"), Qt::CTRL | Qt::Key_F10, this, &MainWindow::insertEmptyLineAction);
     editMenu->addAction(tr("Insert Empty Line and Next"), Qt::Key_F10, this, &MainWindow::insertEmptyLineAndNextAction);
+    auto tapRecorder = new TapRecorder(m_treeView, this);
+    auto tapTimingAction = editMenu->addAction(tr("&Tap Timing"));
+    tapTimingAction->setShortcut(Qt::CTRL | Qt::Key_T);
+    tapTimingAction->setCheckable(true);
+    connect(tapTimingAction, &QAction::toggled, tapRecorder, &TapRecorder::setRecording);
+    connect(tapRecorder, &TapRecorder::recordingChanged, tapTimingAction, &QAction::setChecked);
     editMenu->addSeparator();
     editMenu->addAction(tr("Select &All"), QKeySequence::SelectAll, this, &MainWindow::selectAllAction);
     editMenu->addAction(tr("Deselect All"), QKeySequence::Deselect, this, &MainWindow::selectNoneAction);
@@ -266,6 +300,28 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     auto playbackMenu = menuBar->addMenu(tr("&Playback"));
     playbackMenu->addAction(tr("&Open Audio File..."), Qt::CTRL | Qt::ALT | Qt::Key_O, this, &MainWindow::openAudioFileAction);
     playbackMenu->addAction(tr("&Close Audio File"), Qt::CTRL | Qt::ALT | Qt::Key_W , this, &MainWindow::closeAudioFileAction);
+    auto preDecodeAction = playbackMenu->addAction(tr("&Pre-decode Audio"));
+    preDecodeAction->setCheckable(true);
+    connect(preDecodeAction, &QAction::toggled, playbackController, &PlaybackController::setPreDecodingEnabled);
+    playbackMenu->addSeparator();
+    auto followPlaybackAction = playbackMenu->addAction(tr("&Follow Playback"));
+    followPlaybackAction->setCheckable(true);
+    connect(followPlaybackAction, &QAction::toggled, m_treeView, &LyricTableView::setFollowingPlayback);
+    auto loopCurrentLineAction = playbackMenu->addAction(tr("&Loop Current Line"), Qt::CTRL | Qt::Key_L);
+    loopCurrentLineAction->setCheckable(true);
+    connect(loopCurrentLineAction, &QAction::toggled, this, &MainWindow::setLoopingCurrentLine);
+    auto loopPreRollMenu = playbackMenu->addMenu(tr("Loop P&re-roll"));
+    auto loopPreRollActionGroup = new QActionGroup(this);
+    for (auto preRollTime : {0, 50, 100, 200}) {
+        auto action = loopPreRollMenu->addAction(preRollTime == 0 ? tr("None") : tr("%1 s").arg(preRollTime / 100.0));
+        action->setCheckable(true);
+        action->setChecked(preRollTime == m_loopPreRollTime);
+        loopPreRollActionGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [=] {
+            m_loopPreRollTime = preRollTime;
+            updateLineLoop();
+        });
+    }
 
     m_batchProcessMenu = menuBar->addMenu(tr("&Batch Process"));
     m_batchProcessMenu->addAction(tr("&Reload Scripts"), this, &MainWindow::reloadScriptsAction);
@@ -287,19 +343,19 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
         redoAction->setText(tr("&Redo %1").arg(name));
     });
 
+    auto lyricPreviewTracker = new LyricPreviewTracker(previousLyricLabel, currentLyricLabel, nextLyricLabel, m_treeView, this);
     auto updateAllLyricLabels = [=] {
-        auto currentRow = m_document->findRowByTime(PlaybackController::instance()->positionTime());
-        previousLyricLabel->setRow(qMax(-1, currentRow - 1));
-        currentLyricLabel->setRow(currentRow);
-        nextLyricLabel->setRow(currentRow + 1);
+        lyricPreviewTracker->refresh(PlaybackController::instance()->positionTime());
     };
 
     connect(m_document->model(), &QAbstractItemModel::dataChanged, this, updateAllLyricLabels);
     connect(m_document->model(), &QAbstractItemModel::rowsInserted, this, updateAllLyricLabels);
     connect(m_document->model(), &QAbstractItemModel::rowsRemoved, this, updateAllLyricLabels);
+    connect(m_document->model(), &QAbstractItemModel::modelReset, this, updateAllLyricLabels);
+    connect(m_document->proxyModel(), &QAbstractItemModel::layoutChanged, this, updateAllLyricLabels);
 
     connect(m_selectionModel, &QItemSelectionModel::selectionChanged, this, [=] {
-        auto flag = m_selectionModel->hasSelection();
+        auto flag = m_selection->hasSelection();
         deleteAction->setEnabled(flag);
         quantizeAction->setEnabled(flag);
         adjustTimeAction->setEnabled(flag);
@@ -311,9 +367,35 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
         QSignalBlocker blocker(timeSlider);
         timeSlider->setValue(time);
         currentTimeLabel->setText(TimeValidator::timeToString(time));
-        updateAllLyricLabels();
+        lyricPreviewTracker->setTime(time);
+    });
+    // While the slider is dragged only scrub audio is played, and the transport seeks once on release
+    connect(timeSlider, &QSlider::valueChanged, this, [=](int time) {
+        if (timeSlider->isSliderDown()) {
+            currentTimeLabel->setText(TimeValidator::timeToString(time));
+            playbackController->scrubTo(time);
+        } else {
+            playbackController->setPositionTime(time);
+        }
+    });
+    connect(timeSlider, &QSlider::sliderPressed, playbackController, [=] {
+        playbackController->beginScrub();
+        playbackController->scrubTo(timeSlider->value());
+    });
+    connect(timeSlider, &QSlider::sliderReleased, playbackController, [=] {
+        playbackController->setPositionTime(timeSlider->value());
+        playbackController->endScrub();
+    });
+    connect(playbackRateSpinBox, &QDoubleSpinBox::valueChanged, playbackController, &PlaybackController::setPlaybackRate);
+    connect(playbackController, &PlaybackController::audioFileOpened, this, &MainWindow::openLyricFileForAudio);
+    connect(playbackController, &PlaybackController::audioFileOpened, this, &MainWindow::updateLineLoop);
+    // The loop follows the current line, including edits to its time or the next line's
+    connect(m_selectionModel, &QItemSelectionModel::currentRowChanged, this, &MainWindow::updateLineLoop);
+    connect(m_document->proxyModel(), &QAbstractItemModel::dataChanged, this, &MainWindow::updateLineLoop);
+    connect(m_document->proxyModel(), &QAbstractItemModel::layoutChanged, this, &MainWindow::updateLineLoop);
+    connect(playbackController, &PlaybackController::audioFileOpenFailed, this, [=](const QString &fileName) {
+        QMessageBox::critical(this, {}, tr("Cannot open audio file %1").arg(fileName));
     });
-    connect(timeSlider, &QSlider::valueChanged, playbackController, &PlaybackController::setPositionTime);
     connect(playbackController, &PlaybackController::audioFileNameChanged, this, [=](const QString &fileName) {
         audioFileNameLabel->setText(fileName);
         totalTimeLabel->setText(TimeValidator::timeToString(playbackController->audioLengthTime()));
@@ -327,12 +409,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     }
 
     updateTitle();
-
-    reloadScriptsAction();
-    m_engine = new QJSEngine(this);
-    m_engine->installExtensions(QJSEngine::ConsoleExtension);
-    m_engine->globalObject().setProperty("document", m_engine->newQObject(new DocumentObject));
-
+    recordStartupPhase("user interface");
 }
 
 MainWindow::~MainWindow() {
@@ -347,6 +424,10 @@ QTreeView *MainWindow::treeView() const {
     return m_treeView;
 }
 
+LyricSelection *MainWindow::selection() const {
+    return m_selection;
+}
+
 void MainWindow::updateTitle() {
     setWindowTitle(QString("%1 - %2%3").arg(
             QApplication::applicationName(),
@@ -374,6 +455,39 @@ void MainWindow::closeEvent(QCloseEvent *event) {
         event->ignore();
 }
 
+void MainWindow::showEvent(QShowEvent *event) {
+    QMainWindow::showEvent(event);
+    if (m_isDeferredInitializationScheduled)
+        return;
+    m_isDeferredInitializationScheduled = true;
+    // Let the first frame be painted before doing anything that is not needed for it
+    QTimer::singleShot(0, this, &MainWindow::deferredInitialize);
+}
+
+void MainWindow::deferredInitialize() {
+    recordStartupPhase("first show");
+    if (!PlaybackController::instance()->initialize())
+        QMessageBox::critical(this, {}, tr("Cannot initialize audio"));
+    recordStartupPhase("audio device");
+    reloadScriptsAction();
+    recordStartupPhase("scripts");
+    audioFileFilters();
+    recordStartupPhase("audio formats");
+}
+
+void MainWindow::recordStartupPhase(const char *name) {
+    qCDebug(lcStartup, "%s: %lld ms", name, m_startupTimer.elapsed());
+}
+
+QJSEngine *MainWindow::engine() {
+    if (!m_engine) {
+        m_engine = new QJSEngine(this);
+        m_engine->installExtensions(QJSEngine::ConsoleExtension);
+        m_engine->globalObject().setProperty("document", m_engine->newQObject(new DocumentObject));
+    }
+    return m_engine;
+}
+
 void MainWindow::newFileAction() {
     if (!querySaveFile())
         return;
@@ -420,11 +534,47 @@ bool MainWindow::importAction() {
     ImportDialog dlg;
     if (dlg.exec() == QDialog::Rejected)
         return false;
+
+    QFile f(dlg.fileName());
+    auto text = dlg.text();
+    QTextStream stream;
+    qint64 totalSize;
+    if (dlg.fileName().isEmpty()) {
+        stream.setString(&text, QIODevice::ReadOnly);
+        totalSize = text.size();
+    } else {
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QMessageBox::critical(this, {}, tr("Cannot open file %1").arg(dlg.fileName()));
+            return false;
+        }
+        stream.setDevice(&f);
+        totalSize = f.size();
+    }
+
     m_document->newFile();
-    auto lyrics = dlg.text().split('\n');
-    auto baseTime = dlg.initialTime();
-    for (int i = 0; i < lyrics.size(); i++) {
-        m_document->model()->appendRow({new QStandardItem(QString::number(baseTime + i)), new QStandardItem(lyrics[i])});
+    QProgressDialog progressDialog(tr("Importing..."), tr("Cancel"), 0, 1000, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+    static const int ImportChunkSize = 4096;
+    QList<LyricLine> lyricLines;
+    lyricLines.reserve(ImportChunkSize);
+    auto time = dlg.initialTime();
+    QString line;
+    m_document->beginBatchUpdate();
+    while (!stream.atEnd()) {
+        lyricLines.clear();
+        while (lyricLines.size() < ImportChunkSize && stream.readLineInto(&line))
+            lyricLines.append({time++, line});
+        m_document->appendLyricLines(lyricLines);
+        auto position = f.isOpen() ? f.pos() : stream.pos();
+        progressDialog.setValue(totalSize > 0 ? static_cast<int>(position * 1000 / totalSize) : 0);
+        if (progressDialog.wasCanceled())
+            break;
+    }
+    m_document->endBatchUpdate();
+    if (progressDialog.wasCanceled()) {
+        m_document->newFile();
+        return false;
     }
     return true;
 }
@@ -443,7 +593,7 @@ void MainWindow::redoAction() {
 
 void MainWindow::insertAction() {
     m_document->beginTransaction(tr("Insert"));
-    m_document->pushInsertRowCommand(m_document->model()->rowCount(), PlaybackController::instance()->positionTime(), {});
+    m_document->pushInsertRowCommand(m_document->model()->rowCount(), PlaybackController::instance()->clockTime(), {});
     auto index = m_document->model()->index(m_document->model()->rowCount() - 1, 0);
     m_document->model()->setData(index, 1, Qt::UserRole);
     m_treeView->setCurrentIndex(m_document->proxyModel()->mapFromSource(index));
@@ -451,22 +601,25 @@ void MainWindow::insertAction() {
 }
 
 void MainWindow::deleteAction() {
-    m_document->beginTransaction(tr("Delete"));
-    auto selectedRows = m_selectionModel->selectedRows();
-    for (auto &index : selectedRows) {
-        index = m_document->proxyModel()->mapToSource(index);
+    QList<int> sourceRows;
+    sourceRows.reserve(m_selection->count());
+    for (const auto &range : m_selection->ranges()) {
+        for (int row = range.first; row <= range.last; row++)
+            sourceRows.append(m_document->proxyModel()->mapToSource(m_document->proxyModel()->index(row, 0)).row());
     }
-    std::sort(selectedRows.begin(), selectedRows.end());
-    std::for_each(selectedRows.crbegin(), selectedRows.crend(), [=](const auto &index) {
-        m_document->pushDeleteRowCommand(index.row());
-    });
+    std::sort(sourceRows.begin(), sourceRows.end(), std::greater<>());
+    m_document->beginTransaction(tr("Delete"));
+    m_document->beginBatchUpdate();
+    for (auto row : sourceRows)
+        m_document->pushDeleteRowCommand(row);
+    m_document->endBatchUpdate();
     m_document->commitTransaction();
 }
 
 void MainWindow::setTimeAction() {
     auto currentIndex = m_treeView->currentIndex().siblingAtColumn(0);
     m_document->beginTransaction(tr("Set Time"));
-    m_document->pushEditCommand(currentIndex, PlaybackController::instance()->positionTime());
+    m_document->pushEditCommand(currentIndex, PlaybackController::instance()->clockTime());
     m_document->commitTransaction();
 }
 
@@ -478,7 +631,7 @@ void MainWindow::setTimeAndNextAction() {
 
 void MainWindow::insertEmptyLineAction() {
     m_document->beginTransaction(tr("Insert Empty Line"));
-    m_document->pushInsertRowCommand(m_document->model()->rowCount(), PlaybackController::instance()->positionTime(), {});
+    m_document->pushInsertRowCommand(m_document->model()->rowCount(), PlaybackController::instance()->clockTime(), {});
     m_document->commitTransaction();
     auto index = m_document->model()->index(m_document->model()->rowCount() - 1, 0);
     m_treeView->setCurrentIndex(m_document->proxyModel()->mapFromSource(index));
@@ -491,55 +644,49 @@ void MainWindow::insertEmptyLineAndNextAction() {
 }
 
 void MainWindow::selectAllAction() {
-    m_treeView->selectAll();
+    m_selection->selectAll();
 }
 
 void MainWindow::selectNoneAction() {
-    m_treeView->clearSelection();
+    m_selection->clear();
 }
 
 void MainWindow::quantizeAction() {
     QuantizeDialog dlg;
     if (dlg.exec() == QDialog::Rejected)
         return;
-    auto div = dlg.div();
 
+    TimeTransform transform(m_selection->indexes());
+    transform.quantize(dlg.div());
+    // An empty transaction would still leave an undo step behind
+    if (!transform.hasChanges())
+        return;
     m_document->beginTransaction(tr("Quantize"));
-    for (const auto &index : m_selectionModel->selectedRows()) {
-        auto oldTime = index.model()->data(index).toInt();
-        auto newTime = static_cast<int>(std::round(std::round(oldTime / div) * div));
-        m_document->pushEditCommand(index, newTime);
-    }
+    transform.commit();
     m_document->commitTransaction();
-
 }
 
 void MainWindow::adjustTimeAction() {
     AdjustTimeDialog dlg;
+    TimeTransform selectedTimes(m_selection->indexes());
     retry:
     if (dlg.exec() == QDialog::Rejected)
         return;
 
-    QHash<QModelIndex, int> newTimeDict;
-    auto ratio = dlg.ratio();
-    auto offset = dlg.offset();
-    for (const auto &index : m_selectionModel->selectedRows()) {
-        auto oldTime = index.model()->data(index).toInt();
-        auto newTime = static_cast<int>(std::round(oldTime * ratio + offset));
-        if (newTime < 0) {
-            QMessageBox::warning(this, {}, "Time becomes negative after adjustment. Please retry.");
-            goto retry;
-        }
-        newTimeDict.insert(m_document->proxyModel()->mapToSource(index), newTime);
+    auto transform = selectedTimes;
+    transform.scale(dlg.ratio(), dlg.offset());
+    if (!transform.isValid()) {
+        QMessageBox::warning(this, {}, tr("Time is out of range after adjustment (it must be between %1 and %2). Please retry.").arg(TimeValidator::timeToString(0), TimeValidator::timeToString(TimeValidator::MaximumTime)));
+        goto retry;
     }
+    if (!transform.hasChanges())
+        return;
     m_document->beginTransaction(tr("Adjust Time"));
-    std::for_each(newTimeDict.constKeyValueBegin(), newTimeDict.constKeyValueEnd(), [=](const auto &pair) {
-        m_document->pushEditCommand(pair.first, pair.second);
-    });
+    transform.commit();
     m_document->commitTransaction();
 }
 
-void MainWindow::openAudioFileAction() {
+QString MainWindow::audioFileFilters() {
     static auto filters = ([] {
         QStringList ret;
         std::set<QString> extensions;
@@ -566,13 +713,18 @@ void MainWindow::openAudioFileAction() {
         ret.prepend(tr("All supported files (%1)").arg(allSupportedFileExtensions.join(" ")));
         return ret.join(";;");
     })();
-    auto fileName = QFileDialog::getOpenFileName(this, {}, {}, filters);
+    return filters;
+}
+
+void MainWindow::openAudioFileAction() {
+    auto fileName = QFileDialog::getOpenFileName(this, {}, {}, audioFileFilters());
     if (fileName.isEmpty())
         return;
-    if (!PlaybackController::instance()->openAudioFile(fileName)) {
-        QMessageBox::critical(this, {}, tr("Cannot open audio file %1").arg(fileName));
-        return;
-    }
+    // The result is reported by PlaybackController::audioFileOpened or audioFileOpenFailed
+    PlaybackController::instance()->openAudioFile(fileName);
+}
+
+void MainWindow::openLyricFileForAudio(const QString &fileName) {
     auto lyricFileName = QFileInfo(fileName).dir().filePath(QFileInfo(fileName).baseName() + QStringLiteral(".lrc"));
     if (LyricDocument::instance()->fileName() != lyricFileName) {
         if (!QFileInfo(lyricFileName).isFile())
@@ -591,6 +743,24 @@ void MainWindow::closeAudioFileAction() {
     PlaybackController::instance()->closeAudioFile();
 }
 
+void MainWindow::setLoopingCurrentLine(bool enabled) {
+    m_isLoopingCurrentLine = enabled;
+    updateLineLoop();
+}
+
+void MainWindow::updateLineLoop() {
+    auto playbackController = PlaybackController::instance();
+    auto row = m_treeView->currentIndex().row();
+    if (!m_isLoopingCurrentLine || row == -1) {
+        playbackController->clearLoopRange();
+        return;
+    }
+    auto proxyModel = m_document->proxyModel();
+    auto startTime = proxyModel->data(proxyModel->index(row, 0)).toInt();
+    auto endTime = row + 1 < proxyModel->rowCount() ? proxyModel->data(proxyModel->index(row + 1, 0)).toInt() : playbackController->audioLengthTime();
+    playbackController->setLoopRange(startTime - m_loopPreRollTime, endTime);
+}
+
 static const QDir scriptDir = QDir(QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation)[0]).filePath("NeoLrcEditorApp Scripts");
 
 void MainWindow::reloadScriptsAction() {
@@ -627,7 +797,7 @@ void MainWindow::executeScript(const QString &fileName) {
         return;
     }
     LyricDocument::instance()->beginTransaction(tr("Script %1").arg(QFileInfo(fileName).baseName()));
-    auto ret = m_engine->evaluate(f.readAll(), fileName);
+    auto ret = engine()->evaluate(f.readAll(), fileName);
     if (ret.isError()) {
         QMessageBox::critical(this, tr("Script Error"), ret.toString() + "\n" + ret.property("stack").toString());
         LyricDocument::instance()->abortTransaction();
@@ -2,6 +2,7 @@
 #define NEOLRCEDITORAPP_MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QElapsedTimer>
 
 class QTreeView;
 class QToolBar;
@@ -10,6 +11,8 @@ class QJSEngine;
 
 class LyricDocument;
 class LyricEditorView;
+class LyricSelection;
+class LyricTableView;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -20,11 +23,17 @@ public:
     static MainWindow *instance();
 
     QTreeView *treeView() const;
+    LyricSelection *selection() const;
 
 protected:
     void closeEvent(QCloseEvent *event) override;
+    void showEvent(QShowEvent *event) override;
 
 private:
+    void deferredInitialize();
+    void recordStartupPhase(const char *name);
+    QJSEngine *engine();
+    static QString audioFileFilters();
 
     void updateTitle();
 
@@ -51,7 +60,10 @@ private:
     void adjustTimeAction();
 
     void openAudioFileAction();
+    void openLyricFileForAudio(const QString &fileName);
     void closeAudioFileAction();
+    void setLoopingCurrentLine(bool enabled);
+    void updateLineLoop();
 
     void reloadScriptsAction();
     void openScriptDirAction();
@@ -59,12 +71,19 @@ private:
 
     LyricDocument *m_document;
 
-    QTreeView *m_treeView;
+    LyricTableView *m_treeView;
     LyricEditorView *m_lyricEditorView;
     QItemSelectionModel *m_selectionModel;
+    LyricSelection *m_selection;
+
+    bool m_isLoopingCurrentLine = false;
+    int m_loopPreRollTime = 0;
 
     QMenu *m_batchProcessMenu;
-    QJSEngine *m_engine;
+    QJSEngine *m_engine = nullptr;
+
+    QElapsedTimer m_startupTimer;
+    bool m_isDeferredInitializationScheduled = false;
 };
 
 
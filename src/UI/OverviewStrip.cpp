@@ -0,0 +1,180 @@
+#include "OverviewStrip.h"
+
+#include <algorithm>
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QStandardItemModel>
+
+#include <NeoLrcEditorApp/LyricDocument.h>
+#include <NeoLrcEditorApp/PlaybackController.h>
+#include <NeoLrcEditorApp/WaveformPeakCache.h>
+
+OverviewStrip::OverviewStrip(QWidget *parent) : QWidget(parent), m_bins(BinCount) {
+    setFixedHeight(40);
+    setCursor(Qt::PointingHandCursor);
+
+    auto model = LyricDocument::instance()->model();
+    // Rows of the source model never move, so a list in source row order gives the old time of a changed row without any persistent indexes
+    connect(model, &QStandardItemModel::rowsInserted, this, [=](const QModelIndex &, int first, int last) {
+        m_times.insert(first, last - first + 1, 0);
+        for (int row = first; row <= last; row++) {
+            auto time = model->data(model->index(row, 0)).toInt();
+            m_times[row] = time;
+            addTime(time);
+        }
+        update();
+    });
+    connect(model, &QStandardItemModel::dataChanged, this, [=](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        if (topLeft.column() > 0)
+            return;
+        for (int row = topLeft.row(); row <= bottomRight.row() && row < m_times.size(); row++) {
+            auto time = model->data(model->index(row, 0)).toInt();
+            if (m_times[row] == time)
+                continue;
+            removeTime(m_times[row]);
+            m_times[row] = time;
+            addTime(time);
+        }
+        update();
+    });
+    connect(model, &QStandardItemModel::rowsAboutToBeRemoved, this, [=](const QModelIndex &, int first, int last) {
+        for (int row = first; row <= last; row++)
+            removeTime(m_times[row]);
+        m_times.remove(first, last - first + 1);
+        update();
+    });
+    connect(model, &QStandardItemModel::modelAboutToBeReset, this, [=] {
+        m_times.clear();
+        m_documentSpan = 6000;
+        m_bins.fill(0);
+        update();
+    });
+
+    auto playbackController = PlaybackController::instance();
+    connect(playbackController, &PlaybackController::audioFileNameChanged, this, [=] {
+        rebuildHistogram();
+        update();
+    });
+    connect(playbackController->waveformPeakCache(), &WaveformPeakCache::chunkLoaded, this, qOverload<>(&QWidget::update));
+    connect(playbackController->waveformPeakCache(), &WaveformPeakCache::loadFinished, this, qOverload<>(&QWidget::update));
+    connect(playbackController, &PlaybackController::positionTimeChanged, this, [=](int time) {
+        auto x = static_cast<int>(xFromSecond(time / 100.0));
+        if (x != m_playheadX) {
+            m_playheadX = x;
+            update();
+        }
+    });
+}
+
+OverviewStrip::~OverviewStrip() = default;
+
+void OverviewStrip::setVisibleRange(double startSecond, double endSecond) {
+    if (qFuzzyCompare(m_visibleStartSecond, startSecond) && qFuzzyCompare(m_visibleEndSecond, endSecond))
+        return;
+    m_visibleStartSecond = startSecond;
+    m_visibleEndSecond = endSecond;
+    update();
+}
+
+void OverviewStrip::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().color(QPalette::Base));
+    auto w = width();
+    auto h = height();
+
+    auto peakCache = PlaybackController::instance()->waveformPeakCache();
+    if (peakCache->sampleRate() > 0 && w > 0) {
+        auto samplesPerPixel = spanTime() / 100.0 * peakCache->sampleRate() / w;
+        auto peaks = peakCache->peaks(0, samplesPerPixel, w);
+        QList<QLineF> lines;
+        lines.reserve(w);
+        for (int i = 0; i < w; i++) {
+            auto x = i + 0.5;
+            lines.append({x, h / 2.0 - peaks[i].max * h / 2.0, x, h / 2.0 - peaks[i].min * h / 2.0});
+        }
+        painter.setPen(QColor(0xcc, 0xcc, 0xcc));
+        painter.drawLines(lines);
+    }
+
+    auto maxCount = *std::max_element(m_bins.cbegin(), m_bins.cend());
+    if (maxCount > 0) {
+        auto binWidth = static_cast<double>(w) / BinCount;
+        QColor binColor(0x42, 0x63, 0xeb, 0x9f);
+        for (int i = 0; i < BinCount; i++) {
+            if (!m_bins[i])
+                continue;
+            auto binHeight = static_cast<double>(m_bins[i]) / maxCount * h;
+            painter.fillRect(QRectF(i * binWidth, h - binHeight, binWidth, binHeight), binColor);
+        }
+    }
+
+    auto left = xFromSecond(m_visibleStartSecond);
+    auto right = xFromSecond(m_visibleEndSecond);
+    auto highlightColor = palette().color(QPalette::Highlight);
+    painter.setPen(highlightColor);
+    highlightColor.setAlpha(0x3f);
+    painter.setBrush(highlightColor);
+    painter.drawRect(QRectF(left, 0, qMax(2.0, right - left), h - 1));
+
+    m_playheadX = static_cast<int>(xFromSecond(PlaybackController::instance()->positionTime() / 100.0));
+    if (m_playheadX >= 0) {
+        painter.setPen(Qt::red);
+        painter.drawLine(m_playheadX, 0, m_playheadX, h);
+    }
+}
+
+void OverviewStrip::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton)
+        emit viewportMoveRequested(secondFromX(event->position().x()));
+}
+
+void OverviewStrip::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton)
+        emit viewportMoveRequested(secondFromX(event->position().x()));
+}
+
+int OverviewStrip::spanTime() const {
+    auto audioLengthTime = PlaybackController::instance()->audioLengthTime();
+    return audioLengthTime > 0 ? audioLengthTime : m_documentSpan;
+}
+
+double OverviewStrip::xFromSecond(double second) const {
+    return second * 100.0 / spanTime() * width();
+}
+
+double OverviewStrip::secondFromX(double x) const {
+    return x / qMax(1, width()) * spanTime() / 100.0;
+}
+
+void OverviewStrip::addTime(int time) {
+    if (time < 0)
+        return;
+    if (time >= spanTime()) {
+        // Without audio the strip covers the whole document, so grow it and rebin once
+        if (PlaybackController::instance()->audioLengthTime() == 0)
+            rebuildHistogram();
+        return;
+    }
+    m_bins[static_cast<qint64>(time) * BinCount / spanTime()]++;
+}
+
+void OverviewStrip::removeTime(int time) {
+    if (time < 0 || time >= spanTime())
+        return;
+    m_bins[static_cast<qint64>(time) * BinCount / spanTime()]--;
+}
+
+void OverviewStrip::rebuildHistogram() {
+    if (PlaybackController::instance()->audioLengthTime() == 0) {
+        auto maxTime = m_times.isEmpty() ? 0 : *std::max_element(m_times.cbegin(), m_times.cend());
+        while (m_documentSpan <= maxTime)
+            m_documentSpan *= 2;
+    }
+    m_bins.fill(0);
+    auto span = spanTime();
+    for (auto time : std::as_const(m_times)) {
+        if (time >= 0 && time < span)
+            m_bins[static_cast<qint64>(time) * BinCount / span]++;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef NEOLRCEDITORAPP_OVERVIEWSTRIP_H
+#define NEOLRCEDITORAPP_OVERVIEWSTRIP_H
+
+#include <QWidget>
+#include <QList>
+
+class OverviewStrip : public QWidget {
+    Q_OBJECT
+public:
+    static constexpr int BinCount = 512;
+
+    explicit OverviewStrip(QWidget *parent = nullptr);
+    ~OverviewStrip() override;
+
+    void setVisibleRange(double startSecond, double endSecond);
+
+signals:
+    void viewportMoveRequested(double centerSecond);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    int spanTime() const;
+    double xFromSecond(double second) const;
+    double secondFromX(double x) const;
+
+    void addTime(int time);
+    void removeTime(int time);
+    void rebuildHistogram();
+
+    // Time of each row of the source model
+    QList<int> m_times;
+    QList<int> m_bins;
+    // Span used when no audio file is open; grows to fit the document
+    int m_documentSpan = 6000;
+
+    double m_visibleStartSecond = 0;
+    double m_visibleEndSecond = 0;
+    int m_playheadX = -1;
+};
+
+
+#endif //NEOLRCEDITORAPP_OVERVIEWSTRIP_H
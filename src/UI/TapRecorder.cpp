@@ -0,0 +1,123 @@
+#include "TapRecorder.h"
+
+#include <cmath>
+
+#include <QApplication>
+#include <QKeyEvent>
+#include <QSortFilterProxyModel>
+
+#include <NeoLrcEditorApp/LyricDocument.h>
+#include <NeoLrcEditorApp/LyricTableView.h>
+#include <NeoLrcEditorApp/PlaybackClock.h>
+#include <NeoLrcEditorApp/PlaybackController.h>
+
+bool TapRecorder::TapQueue::push(int time) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) == Capacity)
+        return false;
+    m_times[head % Capacity] = time;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool TapRecorder::TapQueue::pop(int &time) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+        return false;
+    time = m_times[tail % Capacity];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+TapRecorder::TapRecorder(LyricTableView *tableView, QObject *parent) : QObject(parent), m_tableView(tableView) {
+    m_drainTimer.setInterval(100);
+    connect(&m_drainTimer, &QTimer::timeout, this, &TapRecorder::drain);
+}
+
+TapRecorder::~TapRecorder() {
+    if (m_isRecording)
+        qApp->removeEventFilter(this);
+}
+
+void TapRecorder::setRecording(bool isRecording) {
+    if (isRecording == m_isRecording)
+        return;
+    m_isRecording = isRecording;
+    if (isRecording) {
+        m_times.clear();
+        m_startRow = qMax(0, m_tableView->currentIndex().row());
+        m_hasTimestampOffset = false;
+        qApp->installEventFilter(this);
+        m_drainTimer.start();
+    } else {
+        qApp->removeEventFilter(this);
+        m_drainTimer.stop();
+        drain();
+        apply();
+    }
+    emit recordingChanged(isRecording);
+}
+
+bool TapRecorder::isRecording() const {
+    return m_isRecording;
+}
+
+bool TapRecorder::eventFilter(QObject *watched, QEvent *event) {
+    if (event->type() != QEvent::ShortcutOverride && event->type() != QEvent::KeyPress)
+        return false;
+    auto keyEvent = static_cast<QKeyEvent *>(event);
+    if (keyEvent->key() != Qt::Key_F9 || keyEvent->modifiers() != Qt::NoModifier)
+        return false;
+    // Keep F9 from triggering Set Time and Next while recording
+    event->accept();
+    if (event->type() == QEvent::ShortcutOverride || keyEvent->isAutoRepeat())
+        return true;
+
+    // Stamp the tap with the time the key was pressed, not the time the event got here
+    auto now = PlaybackClock::currentTimestamp();
+    auto timestamp = now;
+    if (keyEvent->timestamp()) {
+        auto eventTimestamp = static_cast<qint64>(keyEvent->timestamp()) * 1000000;
+        if (!m_hasTimestampOffset || now - eventTimestamp < m_timestampOffset) {
+            m_timestampOffset = now - eventTimestamp;
+            m_hasTimestampOffset = true;
+        }
+        timestamp = eventTimestamp + m_timestampOffset;
+    }
+    auto second = PlaybackController::instance()->clock().positionSecondAt(timestamp);
+    m_queue.push(static_cast<int>(std::round(second * 100)));
+    return true;
+}
+
+void TapRecorder::drain() {
+    int time;
+    auto tapCount = m_times.size();
+    while (m_queue.pop(time))
+        m_times.append(time);
+    if (m_times.size() == tapCount)
+        return;
+    // Only the view moves during recording, the document is updated once recording stops
+    auto proxyModel = LyricDocument::instance()->proxyModel();
+    auto row = qMin(m_startRow + static_cast<int>(m_times.size()), proxyModel->rowCount() - 1);
+    if (row >= 0)
+        m_tableView->setCurrentIndex(proxyModel->index(row, 0));
+}
+
+void TapRecorder::apply() {
+    auto proxyModel = LyricDocument::instance()->proxyModel();
+    QModelIndexList indexes;
+    QVariantList values;
+    QVariantList previousValues;
+    for (int i = 0; i < m_times.size() && m_startRow + i < proxyModel->rowCount(); i++) {
+        auto index = proxyModel->index(m_startRow + i, 0);
+        indexes.append(index);
+        values.append(m_times[i]);
+        previousValues.append(index.data().toInt());
+    }
+    m_times.clear();
+    if (indexes.isEmpty())
+        return;
+    LyricDocument::instance()->beginTransaction(tr("Tap Timing"));
+    LyricDocument::instance()->pushBatchEditCommand(indexes, values, previousValues);
+    LyricDocument::instance()->commitTransaction();
+}
@@ -0,0 +1,56 @@
+#ifndef NEOLRCEDITORAPP_TAPRECORDER_H
+#define NEOLRCEDITORAPP_TAPRECORDER_H
+
+#include <array>
+#include <atomic>
+
+#include <QObject>
+#include <QTimer>
+
+class LyricTableView;
+
+class TapRecorder : public QObject {
+    Q_OBJECT
+public:
+    explicit TapRecorder(LyricTableView *tableView, QObject *parent = nullptr);
+    ~TapRecorder() override;
+
+    void setRecording(bool isRecording);
+    bool isRecording() const;
+
+signals:
+    void recordingChanged(bool isRecording);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    // Single-producer single-consumer ring of tapped times in centiseconds
+    class TapQueue {
+    public:
+        static constexpr int Capacity = 1024;
+        bool push(int time);
+        bool pop(int &time);
+
+    private:
+        std::array<int, Capacity> m_times = {};
+        std::atomic<quint32> m_head = 0;
+        std::atomic<quint32> m_tail = 0;
+    };
+
+    void drain();
+    void apply();
+
+    LyricTableView *m_tableView;
+    TapQueue m_queue;
+    QTimer m_drainTimer;
+    QList<int> m_times;
+    int m_startRow = 0;
+    // Smallest observed difference between the steady clock and input event timestamps
+    qint64 m_timestampOffset = 0;
+    bool m_hasTimestampOffset = false;
+    bool m_isRecording = false;
+};
+
+
+#endif //NEOLRCEDITORAPP_TAPRECORDER_H
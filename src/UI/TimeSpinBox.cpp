@@ -3,7 +3,7 @@
 #include <NeoLrcEditorApp/TimeValidator.h>
 
 TimeSpinBox::TimeSpinBox(QWidget *parent) : QSpinBox(parent) {
-    setMaximum(599999);
+    setMaximum(TimeValidator::MaximumTime);
 }
 
 TimeSpinBox::~TimeSpinBox() = default;
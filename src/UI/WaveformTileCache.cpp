@@ -0,0 +1,95 @@
+#include "WaveformTileCache.h"
+
+#include <cmath>
+
+#include <QPainter>
+#include <QThread>
+
+#include <NeoLrcEditorApp/WaveformPeakCache.h>
+
+WaveformTileCache::WaveformTileCache(WaveformPeakCache *peakCache, QObject *parent) : QObject(parent), m_peakCache(peakCache), m_cache(MemoryBudget) {
+    m_threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    connect(peakCache, &WaveformPeakCache::cleared, this, [=] {
+        m_threadPool.clear();
+        m_threadPool.waitForDone();
+        m_pendingTiles.clear();
+        m_cache.clear();
+    });
+}
+
+WaveformTileCache::~WaveformTileCache() {
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+QImage WaveformTileCache::tile(double scaleRate, qint64 index, int height) {
+    TileKey key = {scaleRate, index, height};
+    if (auto image = m_cache.object(key))
+        return *image;
+    if (m_pendingTiles.contains(key))
+        return {};
+    m_pendingTiles.insert(key, true);
+    m_threadPool.start([=] {
+        auto image = renderTile(m_peakCache, key);
+        QMetaObject::invokeMethod(this, [=] {
+            auto isValid = m_pendingTiles.take(key);
+            if (isValid)
+                m_cache.insert(key, new QImage(image), image.sizeInBytes());
+            emit tileReady(key.scaleRate, key.index);
+        }, Qt::QueuedConnection);
+    });
+    return {};
+}
+
+void WaveformTileCache::invalidate() {
+    m_cache.clear();
+    for (auto &isValid : m_pendingTiles)
+        isValid = false;
+}
+
+void WaveformTileCache::invalidate(double startSecond, double lengthSecond) {
+    auto endSecond = startSecond + lengthSecond;
+    for (const auto &key : m_cache.keys()) {
+        if (overlaps(key, startSecond, endSecond))
+            m_cache.remove(key);
+    }
+    for (auto it = m_pendingTiles.begin(); it != m_pendingTiles.end(); it++) {
+        if (overlaps(it.key(), startSecond, endSecond))
+            it.value() = false;
+    }
+}
+
+QImage WaveformTileCache::renderTile(WaveformPeakCache *peakCache, const TileKey &key) {
+    QImage image(TileWidth, key.height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    auto sampleRate = peakCache->sampleRate();
+    if (sampleRate <= 0 || key.height <= 0)
+        return image;
+    auto samplesPerPixel = sampleRate / (100.0 * std::pow(2, key.scaleRate));
+    auto peaks = peakCache->peaks(static_cast<double>(key.index * TileWidth) * samplesPerPixel, samplesPerPixel, TileWidth);
+    auto halfHeight = key.height / 2.0;
+    QList<QLineF> peakLines;
+    QList<QLineF> rmsLines;
+    peakLines.reserve(TileWidth);
+    rmsLines.reserve(TileWidth);
+    for (int i = 0; i < TileWidth; i++) {
+        const auto &peak = peaks[i];
+        auto x = i + 0.5;
+        peakLines.append({x, halfHeight - peak.max * halfHeight, x, halfHeight - peak.min * halfHeight});
+        rmsLines.append({x, halfHeight - peak.rms * halfHeight, x, halfHeight + peak.rms * halfHeight});
+    }
+    QPainter painter(&image);
+    painter.setPen(QColor(0xcc, 0xcc, 0xcc));
+    painter.drawLines(peakLines);
+    painter.setPen(QColor(0xaa, 0xaa, 0xaa));
+    painter.drawLines(rmsLines);
+    return image;
+}
+
+bool WaveformTileCache::overlaps(const TileKey &key, double startSecond, double endSecond) {
+    // Coarse levels merge neighbouring chunks, so pad the tile by a few pixels
+    auto pixelsPerSecond = 100.0 * std::pow(2, key.scaleRate);
+    auto tileStartSecond = (static_cast<double>(key.index * TileWidth) - 2.0) / pixelsPerSecond;
+    auto tileEndSecond = (static_cast<double>((key.index + 1) * TileWidth) + 2.0) / pixelsPerSecond;
+    return tileStartSecond < endSecond && startSecond < tileEndSecond;
+}
@@ -0,0 +1,56 @@
+#ifndef NEOLRCEDITORAPP_WAVEFORMTILECACHE_H
+#define NEOLRCEDITORAPP_WAVEFORMTILECACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QThreadPool>
+
+class WaveformPeakCache;
+
+class WaveformTileCache : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int TileWidth = 256;
+    // Bytes of rendered tiles kept around; least recently used tiles are dropped beyond that
+    static constexpr qsizetype MemoryBudget = 64 << 20;
+
+    explicit WaveformTileCache(WaveformPeakCache *peakCache, QObject *parent = nullptr);
+    ~WaveformTileCache() override;
+
+    QImage tile(double scaleRate, qint64 index, int height);
+
+    void invalidate();
+    void invalidate(double startSecond, double lengthSecond);
+
+signals:
+    void tileReady(double scaleRate, qint64 index);
+
+private:
+    struct TileKey {
+        double scaleRate;
+        qint64 index;
+        int height;
+
+        bool operator==(const TileKey &o) const {
+            return scaleRate == o.scaleRate && index == o.index && height == o.height;
+        }
+
+        friend size_t qHash(const TileKey &key, size_t seed = 0) {
+            return qHashMulti(seed, key.scaleRate, key.index, key.height);
+        }
+    };
+
+    static QImage renderTile(WaveformPeakCache *peakCache, const TileKey &key);
+    static bool overlaps(const TileKey &key, double startSecond, double endSecond);
+
+    WaveformPeakCache *m_peakCache;
+    QCache<TileKey, QImage> m_cache;
+    // Tiles being rendered; false if the region was invalidated while rendering
+    QHash<TileKey, bool> m_pendingTiles;
+    QThreadPool m_threadPool;
+};
+
+
+#endif //NEOLRCEDITORAPP_WAVEFORMTILECACHE_H
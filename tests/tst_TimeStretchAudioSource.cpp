@@ -0,0 +1,99 @@
+#include <cmath>
+#include <numbers>
+
+#include <QTest>
+
+#include <TalcsCore/AudioSource.h>
+#include <TalcsCore/AudioBuffer.h>
+
+#include "NullAudioOutput.h"
+#include "TimeStretchAudioSource.h"
+
+// An endless sine that counts how many frames have been pulled from it
+class SineAudioSource : public talcs::AudioSource {
+public:
+    qint64 readLength() const {
+        return m_position;
+    }
+
+protected:
+    qint64 processReading(const talcs::AudioSourceReadData &readData) override {
+        for (int channel = 0; channel < readData.buffer->channelCount(); channel++) {
+            auto data = readData.buffer->data(channel) + readData.startPos;
+            for (qint64 i = 0; i < readData.length; i++)
+                data[i] = static_cast<float>(0.5 * std::sin(2.0 * std::numbers::pi * 440.0 * (m_position + i) / 48000.0));
+        }
+        m_position += readData.length;
+        return readData.length;
+    }
+
+private:
+    qint64 m_position = 0;
+};
+
+class tst_TimeStretchAudioSource : public QObject {
+    Q_OBJECT
+private slots:
+    void passThrough() {
+        SineAudioSource source;
+        TimeStretchAudioSource timeStretch(&source);
+        NullAudioOutput output(&timeStretch);
+        QVERIFY(output.start(NullAudioOutput::Offline, 512, 48000));
+        auto renderedLength = output.render(48000);
+        QCOMPARE(source.readLength(), renderedLength);
+        QCOMPARE(timeStretch.latency(), qint64(0));
+    }
+
+    void consumedRatio_data() {
+        QTest::addColumn<double>("speed");
+        QTest::newRow("0.5") << 0.5;
+        QTest::newRow("0.75") << 0.75;
+        QTest::newRow("1.25") << 1.25;
+        QTest::newRow("1.5") << 1.5;
+    }
+
+    void consumedRatio() {
+        QFETCH(double, speed);
+        SineAudioSource source;
+        TimeStretchAudioSource timeStretch(&source);
+        timeStretch.setSpeed(speed);
+        NullAudioOutput output(&timeStretch);
+        QVERIFY(output.start(NullAudioOutput::Offline, 512, 48000));
+        auto renderedLength = output.render(10 * 48000);
+        QCOMPARE(timeStretch.appliedSpeed(), speed);
+        // Frames read ahead by the stretcher have not been played yet
+        auto playedLength = static_cast<double>(source.readLength() - timeStretch.latency());
+        QVERIFY2(std::abs(playedLength / renderedLength - speed) < 0.02 * speed, qPrintable(QString::number(playedLength / renderedLength)));
+    }
+
+    void speedChangeKeepsPosition() {
+        SineAudioSource source;
+        TimeStretchAudioSource timeStretch(&source);
+        timeStretch.setSpeed(0.75);
+        NullAudioOutput output(&timeStretch);
+        QVERIFY(output.start(NullAudioOutput::Offline, 512, 48000));
+        output.render(48000);
+        auto playedLength = source.readLength() - timeStretch.latency();
+        // Changing the speed continues from the buffered input instead of starting over
+        timeStretch.setSpeed(1.25);
+        output.render(512);
+        auto nextPlayedLength = source.readLength() - timeStretch.latency();
+        QVERIFY(nextPlayedLength > playedLength);
+        QVERIFY(nextPlayedLength - playedLength < 2 * 512);
+    }
+
+    void render() {
+        SineAudioSource source;
+        TimeStretchAudioSource timeStretch(&source);
+        timeStretch.setSpeed(0.75);
+        NullAudioOutput output(&timeStretch);
+        QVERIFY(output.start(NullAudioOutput::Offline, 512, 48000));
+        QBENCHMARK {
+            output.render(48000);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_TimeStretchAudioSource)
+
+#include "tst_TimeStretchAudioSource.moc"